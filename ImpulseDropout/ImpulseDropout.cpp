@@ -23,317 +23,102 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "SC_PlugIn.h"
+#include "impulseengine.hpp"
+#include "impulsebank.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#include "rtmem.hpp"
 
 static InterfaceTable *ft;
 
-// This is a copy of the static function from LFUGens.cpp in server/plugins.
-// It detects if a phasor is out-of-bounds, triggers, and wraps [0, 1].
-static inline float testWrapPhase(double prev_inc, double& phase) {
-    if (prev_inc < 0.f) { // negative freqs
-        if (phase <= 0.f) {
-            phase += 1.f;
-            if (phase <= 0.f) { // catch large phase jumps
-                phase -= sc_ceil(phase);
-            }
-            return 1.f;
-        } else {
-            return 0.f;
-        }
-    } else { // positive freqs
-        if (phase >= 1.f) {
-            phase -= 1.f;
-            if (phase >= 1.f) {
-                phase -= sc_floor(phase);
-            }
-            return 1.f;
-        } else {
-            return 0.f;
-        }
-    }
-}
-
 // Represents an ImpulseDropout UGen.
-struct ImpulseDropout : public Unit {
-    double mPhase, mPhaseOffset, mPhaseIncrement;
+struct ImpulseDropout : public ImpulseUnit {};
+
+// Represents an ImpulseDropoutBank UGen. The inputs are numStreams frequencies,
+// followed by numStreams phases, numStreams dropout fractions and the seed.
+struct ImpulseDropoutBank : public Unit {
+    ImpulseBank mBank;
     float mFreqMul;
+    CounterRNG mRNG;
 };
 
-void ImpulseDropout_Ctor(ImpulseDropout* unit);
-void ImpulseDropout_next_aa(ImpulseDropout* unit, int inNumSamples);
-void ImpulseDropout_next_ai(ImpulseDropout* unit, int inNumSamples);
-void ImpulseDropout_next_ak(ImpulseDropout* unit, int inNumSamples);
-void ImpulseDropout_next_ki(ImpulseDropout* unit, int inNumSamples);
-void ImpulseDropout_next_kk(ImpulseDropout* unit, int inNumSamples);
-
-void ImpulseDropout_next_aa(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float* freqIn = IN(0);
-    float* offIn = IN(1);
-    float dropProbIn = IN0(2);
-    
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-    double prevOff = unit->mPhaseOffset;
-    
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        double off = static_cast<double>(offIn[xxn]);
-        double offInc = off - prevOff;
-        phase += offInc;
-        testWrapPhase(inc, phase);
-        inc = freqIn[xxn] * freqMul;
-        out[xxn] = impulseResult;
-        phase += inc;
-        prevOff = off;
-    }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = prevOff;
-    unit->mPhaseIncrement = inc;
+// Construct the ImpulseDropout
+void ImpulseDropout_Ctor(ImpulseDropout* unit) {
+    impulseEngineCtor<ImpulseDropout, Dropout<2>, NoJitter, 3, 4>(unit);
 }
 
-void ImpulseDropout_next_ai(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float freqIn = IN0(0);
-    float dropProbIn = IN0(2);
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
+void ImpulseDropoutBank_next(ImpulseDropoutBank* unit, int inNumSamples) {
+    ImpulseBank* bank = &unit->mBank;
+    int numStreams = bank->numStreams;
+    // A single output means the streams are mixed
+    bool mix = unit->mNumOutputs == 1;
+
+    // Zero out the output buffers. Only the impulses are written below.
+    for (uint32 ch = 0; ch < unit->mNumOutputs; ch++) {
+        float* out = OUT(ch);
+        for (int xxn = 0; xxn < inNumSamples; xxn++) {
+            out[xxn] = 0.f;
         }
-        inc = freqIn * freqMul;
-        out[xxn] = impulseResult;
-        phase += inc;
     }
 
-    unit->mPhase = phase;
-    unit->mPhaseIncrement = inc;
-}
-
-void ImpulseDropout_next_ak(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float freqIn = IN0(0);
-    double off = IN0(1);
-    float dropProbIn = IN0(2);
-    
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-    double prevOff = unit->mPhaseOffset;
-
-    double offSlope = CALCSLOPE(off, prevOff);
-    bool offChanged = offSlope != 0.f;
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        if (offChanged) {
-            phase += offSlope;
-            testWrapPhase(inc, phase);
-        }
-        inc = freqIn * freqMul;
-        out[xxn] = impulseResult;
-        phase += inc;
+    // Advance all of the phasors together
+    for (int k = 0; k < numStreams; k++) {
+        bank->inc[k] = IN0(k) * unit->mFreqMul;
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = off;
-    unit->mPhaseIncrement = inc;
-}
-
-void ImpulseDropout_next_ki(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    double inc = IN0(0) * unit->mFreqMul;
-    float dropProbIn = IN0(2);
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double prevInc = unit->mPhaseIncrement;
-    
-    double incSlope = CALCSLOPE(inc, prevInc);
-    
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(prevInc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        out[xxn] = impulseResult;
-        prevInc += incSlope;
-        phase += prevInc;
+    impulseBankAdvance(bank, inNumSamples);
+
+    CounterRNG* rng = &unit->mRNG;
+    for (int k = 0; k < numStreams; k++) {
+        float* out = mix ? OUT(0) : OUT(k);
+        float dropProbIn = IN0(2 * numStreams + k);
+        impulseBankForEachImpulse(bank, k, inNumSamples, [&](int xxn) {
+            uint32 rand[4];
+            philox(rng->mKey, rng->mCounter++, 0, rand);
+            // Drop the impulse if necessary
+            if (rngUniform(rand[0]) >= dropProbIn) {
+                out[xxn] += 1.f;
+            }
+        });
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseIncrement = inc;
 }
 
-void ImpulseDropout_next_kk(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    double inc = IN0(0) * unit->mFreqMul;
-    double off = IN0(1);
-    float dropProbIn = IN0(2);
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double prevInc = unit->mPhaseIncrement;
-    double prevOff = unit->mPhaseOffset;
-    
-    double incSlope = CALCSLOPE(inc, prevInc);
-    double phaseSlope = CALCSLOPE(off, prevOff);
-    bool phOffChanged = phaseSlope != 0.f;
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(prevInc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        if (phOffChanged) {
-            phase += phaseSlope;
-            testWrapPhase(prevInc, phase);
-        }
-        out[xxn] = impulseResult;
-        prevInc += incSlope;
-        phase += prevInc;
+// Construct the ImpulseDropoutBank
+void ImpulseDropoutBank_Ctor(ImpulseDropoutBank* unit) {
+    int numStreams = unit->mNumInputs / 3;
+    unit->mFreqMul = static_cast<float>(unit->mRate->mSampleDur);
+    void* memory = rtMemAlloc(unit, "ImpulseDropoutBank", impulseBankSize(numStreams));
+    if (!memory) {
+        unit->mBank.phase = nullptr;
+        SETCALC(*ClearUnitOutputs);
+        ClearUnitOutputs(unit, 1);
+        return;
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = off;
-    unit->mPhaseIncrement = inc;
-}
-
-void ImpulseDropout_next_ii(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float dropProbIn = IN0(2);
-    
-    // Collect UGen state
-    double inc = unit->mPhaseIncrement;
-    double phase = unit->mPhase;
-        
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        out[xxn] = impulseResult;
-        phase += inc;
+    impulseBankInit(&unit->mBank, memory, numStreams);
+    rngInit(unit, &unit->mRNG, 3 * numStreams);
+    for (int k = 0; k < numStreams; k++) {
+        unit->mBank.inc[k] = IN0(k) * unit->mFreqMul;
+        impulseBankSetPhase(&unit->mBank, k, IN0(numStreams + k));
     }
 
-    unit->mPhase = phase;
-}
-
-void ImpulseDropout_next_ik(ImpulseDropout* unit, int inNumSamples) {
-    float* out = OUT(0);
-    double off = IN0(1);
-    float dropProbIn = IN0(2);
+    SETCALC(ImpulseDropoutBank_next);
+    ImpulseDropoutBank_next(unit, 1);
 
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    double prevOff = unit->mPhaseOffset;
-
-    double phaseSlope = CALCSLOPE(off, prevOff);
-    bool phOffChanged = phaseSlope != 0.f;
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        // Drop the impulse if necessary
-        if (impulseResult > 0.5f && rgen.frand() < dropProbIn) {
-            impulseResult = 0.f;
-        }
-        if (phOffChanged) {
-            phase += phaseSlope;
-            testWrapPhase(inc, phase);
-        }
-        out[xxn] = impulseResult;
-        phase += inc;
+    unit->mRNG.mCounter = 0;
+    for (int k = 0; k < numStreams; k++) {
+        impulseBankSetPhase(&unit->mBank, k, IN0(numStreams + k));
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = off;
 }
 
-// Construct the ImpulseDropout
-void ImpulseDropout_Ctor(ImpulseDropout* unit) {
-    unit->mPhaseIncrement = IN0(0) * unit->mFreqMul;
-    unit->mPhaseOffset = IN0(1);
-    unit->mFreqMul = static_cast<float>(unit->mRate->mSampleDur);
-
-    double initOff = unit->mPhaseOffset;
-    double initInc = unit->mPhaseIncrement;
-    double initPhase = sc_wrap(initOff, 0.0, 1.0);
-
-    // Initial phase offset of 0 means output of 1 on first sample.
-    // Set phase to wrap point to trigger impulse on first sample
-    if (initPhase == 0.0 && initInc >= 0.0) {
-        initPhase = 1.0; // positive frequency trigger/wrap position
-    }
-    unit->mPhase = initPhase;
-
-    UnitCalcFunc func;
-    switch (INRATE(0)) {
-    case calc_FullRate:
-        switch (INRATE(1)) {
-        case calc_ScalarRate:
-            func = (UnitCalcFunc)ImpulseDropout_next_ai;
-            break;
-        case calc_BufRate:
-            func = (UnitCalcFunc)ImpulseDropout_next_ak;
-            break;
-        case calc_FullRate:
-            func = (UnitCalcFunc)ImpulseDropout_next_aa;
-            break;
-        }
-        break;
-    case calc_BufRate:
-        if (INRATE(1) == calc_ScalarRate) {
-            func = (UnitCalcFunc)ImpulseDropout_next_ki;
-        } else {
-            func = (UnitCalcFunc)ImpulseDropout_next_kk;
-        }
-        break;
-    case calc_ScalarRate:
-        if (INRATE(1) == calc_ScalarRate) {
-            func = (UnitCalcFunc)ImpulseDropout_next_ki;
-        } else {
-            func = (UnitCalcFunc)ImpulseDropout_next_kk;
-        }
-        break;
-    }
-    unit->mCalcFunc = func;
-    func(unit, 1);
-
-    unit->mPhase = initPhase;
-    unit->mPhaseOffset = initOff;
-    unit->mPhaseIncrement = initInc;
+void ImpulseDropoutBank_Dtor(ImpulseDropoutBank* unit) {
+    rtMemFree(unit->mWorld, unit->mBank.phase);
 }
 
 PluginLoad(ImpulseDropout) {
     ft = inTable;
+    profileInit(ft, "ImpulseDropout");
+    rtMemInit(ft, "ImpulseDropout");
+    impulseBankAdvance_select(cpuDetectLevel());
+    blitTableInit();
     DefineSimpleUnit(ImpulseDropout);
+    DefineDtorUnit(ImpulseDropoutBank);
 }
\ No newline at end of file
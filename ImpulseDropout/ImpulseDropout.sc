@@ -24,12 +24,38 @@
 // ImpulseDropout is a version of Impulse that randomly drops a percentage of the impulses.
 ImpulseDropout : UGen {
     *ar {
-        arg freq = 440.0, phase = 0.0, dropFrac = 0.0, mul = 1.0, add = 0.0;
-        ^this.multiNew('audio', freq, phase, dropFrac).madd(mul, add);
+        arg freq = 440.0, phase = 0.0, dropFrac = 0.0, mul = 1.0, add = 0.0, bandLimit = 0, seed = -1;
+        ^this.multiNew('audio', freq, phase, dropFrac, bandLimit, seed).madd(mul, add);
     }
     *kr {
-        arg freq = 440.0, phase = 0.0, dropFrac = 0.0, mul = 1.0, add = 0.0;
-        ^this.multiNew('control', freq, phase, dropFrac).madd(mul, add);
+        arg freq = 440.0, phase = 0.0, dropFrac = 0.0, mul = 1.0, add = 0.0, bandLimit = 0, seed = -1;
+        ^this.multiNew('control', freq, phase, dropFrac, bandLimit, seed).madd(mul, add);
+    }
+    signalRange { ^\unipolar }
+}
+
+// ImpulseDropoutBank runs many ImpulseDropout streams in a single UGen.
+// Each stream has its own frequency, initial phase and dropout fraction.
+// If mix is true, the streams are summed to a single output channel.
+ImpulseDropoutBank : MultiOutUGen {
+    *ar {
+        arg freqs = #[440.0], phases = 0.0, dropFracs = 0.0, mix = false, mul = 1.0, add = 0.0, seed = -1;
+        ^this.newBank('audio', freqs, phases, dropFracs, mix, seed).madd(mul, add);
+    }
+    *kr {
+        arg freqs = #[440.0], phases = 0.0, dropFracs = 0.0, mix = false, mul = 1.0, add = 0.0, seed = -1;
+        ^this.newBank('control', freqs, phases, dropFracs, mix, seed).madd(mul, add);
+    }
+    *newBank {
+        arg rate, freqs, phases, dropFracs, mix, seed;
+        var numStreams = freqs.asArray.size;
+        ^this.new1(rate, numStreams, mix, *(freqs.asArray ++ phases.asArray.wrapExtend(numStreams)
+            ++ dropFracs.asArray.wrapExtend(numStreams) ++ [seed]));
+    }
+    init {
+        arg numStreams, mix ... theInputs;
+        inputs = theInputs;
+        ^this.initOutputs(if(mix, 1, numStreams), rate);
     }
     signalRange { ^\unipolar }
 }
@@ -23,386 +23,141 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "SC_PlugIn.h"
-#include "arrayheap.hpp"
-#include <stdio.h>
-#define HEAP_MAX_SIZE 1024
+#include "impulseengine.hpp"
+#include "impulsebank.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#include "rtmem.hpp"
+#define BANK_MAX_PENDING 16
 
 static InterfaceTable *ft;
 
-// This is a copy of the static function from LFUGens.cpp in server/plugins.
-// It detects if a phasor is out-of-bounds, triggers, and wraps [0, 1].
-static inline float testWrapPhase(double prev_inc, double& phase) {
-    if (prev_inc < 0.f) { // negative freqs
-        if (phase <= 0.f) {
-            phase += 1.f;
-            if (phase <= 0.f) { // catch large phase jumps
-                phase -= sc_ceil(phase);
-            }
-            return 1.f;
-        } else {
-            return 0.f;
-        }
-    } else { // positive freqs
-        if (phase >= 1.f) {
-            phase -= 1.f;
-            if (phase >= 1.f) {
-                phase -= sc_floor(phase);
-            }
-            return 1.f;
-        } else {
-            return 0.f;
-        }
-    }
-}
-
 // Represents an ImpulseJitter UGen.
-struct ImpulseJitter : public Unit {
-    double mPhase, mPhaseOffset, mPhaseIncrement;
+struct ImpulseJitter : public ImpulseHeapUnit {};
+
+// Represents an ImpulseJitterBank UGen. The inputs are numStreams frequencies,
+// followed by numStreams phases, numStreams jitter fractions and the seed.
+struct ImpulseJitterBank : public Unit {
+    ImpulseBank mBank;
     float mFreqMul;
-    IntMinHeap mImpulseHeap;
+    int* mPending;     // impulses jittered past the current block, BANK_MAX_PENDING per stream
+    int* mNumPending;  // the number of pending impulses of each stream
+    CounterRNG mRNG;
 };
 
-void ImpulseJitter_next_aa(ImpulseJitter* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float* freq = IN(0);
-    float* offIn = IN(1);
-    float jitterFracIn = IN0(2);
-    
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-    double prevOff = unit->mPhaseOffset;
-    
-    // The maximum distance an impulse can be displaced
-    int jitterWidth = static_cast<int>(jitterFracIn * unit->mImpulseHeap.maxSize);
-
-    // Zero out the output buffer
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        out[xxn] = 0.f;
-    }
-
-    // Update the impulse table indices
-    for (int xxn = 1; xxn < unit->mImpulseHeap.size; xxn++) {
-        unit->mImpulseHeap.heap[xxn] -= inNumSamples;
-    }
-
-    // Retrieve impulses for this block
-    while (heapPeek(&unit->mImpulseHeap) < inNumSamples && unit->mImpulseHeap.size > 1) {
-        out[heapPop(&unit->mImpulseHeap)] = 1.f;
-    }
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        size_t heapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_log2(freq[xxn])));
-        float impulseResult = testWrapPhase(inc, phase);
-        if (impulseResult > 0.5f) {
-            int idx = rgen.irand(jitterWidth) + xxn;
-            if (idx < inNumSamples) {
-                out[idx] = 1.f;
-            } else if (unit->mImpulseHeap.size < heapEffectiveSize) {
-                heapInsert(&unit->mImpulseHeap, idx);
-            }
-        }
-        double off = static_cast<double>(offIn[xxn]);
-        double offInc = off - prevOff;
-        phase += offInc;
-        testWrapPhase(inc, phase);
-        inc = freq[xxn] * freqMul;
-        phase += inc;
-        prevOff = off;
+// Construct the ImpulseJitter
+void ImpulseJitter_Ctor(ImpulseJitter* unit) {
+    unit->mImpulseHeap.maxSize = HEAP_MAX_SIZE;  // hard coded for now
+    unit->mImpulseHeap.size = 1;
+    unit->mImpulseHeap.heap = (int*)rtMemAlloc(unit, "ImpulseJitter", HEAP_MAX_SIZE * sizeof(int));
+    if (!unit->mImpulseHeap.heap) {
+        SETCALC(*ClearUnitOutputs);
+        ClearUnitOutputs(unit, 1);
+        return;
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = prevOff;
-    unit->mPhaseIncrement = inc;
+    impulseEngineCtor<ImpulseJitter, NoDropout, Jitter<2>, 3, 4>(unit);
 }
 
-void ImpulseJitter_next_ai(ImpulseJitter* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float freq = IN0(0);
-    float jitterFracIn = IN0(2);
-    size_t heapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_log2(freq)));
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-
-    // The maximum distance an impulse can be displaced
-    int jitterWidth = static_cast<int>(jitterFracIn * unit->mImpulseHeap.maxSize);
-
-    // Zero out the output buffer
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        out[xxn] = 0.f;
-    }
-
-    // Update the impulse table indices
-    for (int xxn = 1; xxn < unit->mImpulseHeap.size; xxn++) {
-        unit->mImpulseHeap.heap[xxn] -= inNumSamples;
-    }
-
-    // Retrieve impulses for this block
-    while (heapPeek(&unit->mImpulseHeap) < inNumSamples && unit->mImpulseHeap.size > 1) {
-        out[heapPop(&unit->mImpulseHeap)] = 1.f;
-    }
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        if (impulseResult > 0.5f) {
-            int idx = rgen.irand(jitterWidth) + xxn;
-            if (idx < inNumSamples) {
-                out[idx] = 1.f;
-            } else if (unit->mImpulseHeap.size < heapEffectiveSize) {
-                heapInsert(&unit->mImpulseHeap, idx);
-            }
-        }
-        inc = freq * freqMul;
-        phase += inc;
-    }
-
-    unit->mPhase = phase;
-    unit->mPhaseIncrement = inc;
+void ImpulseJitter_Dtor(ImpulseJitter* unit) {
+    rtMemFree(unit->mWorld, unit->mImpulseHeap.heap);
 }
 
-void ImpulseJitter_next_ak(ImpulseJitter* unit, int inNumSamples) {
-    float* out = OUT(0);
-    float freq = IN0(0);
-    double off = IN0(1);
-    float jitterFracIn = IN0(2);
-    size_t heapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_log2(freq)));
-    
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double inc = unit->mPhaseIncrement;
-    float freqMul = unit->mFreqMul;
-    double prevOff = unit->mPhaseOffset;
-
-    double offSlope = CALCSLOPE(off, prevOff);
-    bool offChanged = offSlope != 0.f;
-
-    // The maximum distance an impulse can be displaced
-    int jitterWidth = static_cast<int>(jitterFracIn * unit->mImpulseHeap.maxSize);
-
-    // Zero out the output buffer
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        out[xxn] = 0.f;
-    }
-
-    // Update the impulse table indices
-    for (int xxn = 1; xxn < unit->mImpulseHeap.size; xxn++) {
-        unit->mImpulseHeap.heap[xxn] -= inNumSamples;
-    }
-
-    // Retrieve impulses for this block
-    while (heapPeek(&unit->mImpulseHeap) < inNumSamples && unit->mImpulseHeap.size > 1) {
-        out[heapPop(&unit->mImpulseHeap)] = 1.f;
-    }
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(inc, phase);
-        if (impulseResult > 0.5f) {
-            int idx = rgen.irand(jitterWidth) + xxn;
-            if (idx < inNumSamples) {
-                out[idx] = 1.f;
-            } else if (unit->mImpulseHeap.size < heapEffectiveSize) {
-                heapInsert(&unit->mImpulseHeap, idx);
-            }
+void ImpulseJitterBank_next(ImpulseJitterBank* unit, int inNumSamples) {
+    ImpulseBank* bank = &unit->mBank;
+    int numStreams = bank->numStreams;
+    // A single output means the streams are mixed
+    bool mix = unit->mNumOutputs == 1;
+
+    // Zero out the output buffers. Only the impulses are written below.
+    for (uint32 ch = 0; ch < unit->mNumOutputs; ch++) {
+        float* out = OUT(ch);
+        for (int xxn = 0; xxn < inNumSamples; xxn++) {
+            out[xxn] = 0.f;
         }
-        if (offChanged) {
-            phase += offSlope;
-            testWrapPhase(inc, phase);
-        }
-        inc = freq * freqMul;
-        phase += inc;
     }
 
-    unit->mPhase = phase;
-    unit->mPhaseOffset = off;
-    unit->mPhaseIncrement = inc;
-}
-
-void ImpulseJitter_next_ki(ImpulseJitter* unit, int inNumSamples) {
-    float* out = OUT(0);
-    double freq = IN0(0);
-    double inc = freq * unit->mFreqMul;
-    float jitterFracIn = IN0(2);
-    size_t heapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_log2(freq)));
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double prevInc = unit->mPhaseIncrement;
-    
-    double incSlope = CALCSLOPE(inc, prevInc);
-    
-    // The maximum distance an impulse can be displaced
-    int jitterWidth = static_cast<int>(jitterFracIn * unit->mImpulseHeap.maxSize);
-
-    // Zero out the output buffer
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        out[xxn] = 0.f;
+    // Advance all of the phasors together
+    for (int k = 0; k < numStreams; k++) {
+        bank->inc[k] = IN0(k) * unit->mFreqMul;
     }
+    impulseBankAdvance(bank, inNumSamples);
 
-    // Update the impulse table indices
-    for (int xxn = 1; xxn < unit->mImpulseHeap.size; xxn++) {
-        unit->mImpulseHeap.heap[xxn] -= inNumSamples;
-    }
+    CounterRNG* rng = &unit->mRNG;
+    for (int k = 0; k < numStreams; k++) {
+        float* out = mix ? OUT(0) : OUT(k);
+        int* pending = unit->mPending + k * BANK_MAX_PENDING;
+        int numPending = unit->mNumPending[k];
 
-    // Retrieve impulses for this block
-    while (heapPeek(&unit->mImpulseHeap) < inNumSamples && unit->mImpulseHeap.size > 1) {
-        out[heapPop(&unit->mImpulseHeap)] = 1.f;
-    }
+        // The maximum distance an impulse can be displaced
+        int jitterWidth = static_cast<int>(IN0(2 * numStreams + k) * HEAP_MAX_SIZE);
 
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(prevInc, phase);
-        if (impulseResult > 0.5f) {
-            int idx = rgen.irand(jitterWidth) + xxn;
-            if (idx < inNumSamples) {
-                out[idx] = 1.f;
-            } else if (unit->mImpulseHeap.size < heapEffectiveSize) {
-                heapInsert(&unit->mImpulseHeap, idx);
+        // Retrieve pending impulses for this block. The rest move one block closer.
+        int numKept = 0;
+        for (int i = 0; i < numPending; i++) {
+            if (pending[i] < inNumSamples) {
+                out[pending[i]] += 1.f;
+            } else {
+                pending[numKept++] = pending[i] - inNumSamples;
             }
         }
-        prevInc += incSlope;
-        phase += prevInc;
-    }
-
-    unit->mPhase = phase;
-    unit->mPhaseIncrement = inc;
-}
-
-void ImpulseJitter_next_kk(ImpulseJitter* unit, int inNumSamples) {
-    float* out = OUT(0);
-    double freq = IN0(0);
-    double inc = freq * unit->mFreqMul;
-    double off = IN0(1);
-    float jitterFracIn = IN0(2);
-    size_t heapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_log2(freq)));
-
-    // Collect UGen state
-    double phase = unit->mPhase;
-    double prevInc = unit->mPhaseIncrement;
-    double prevOff = unit->mPhaseOffset;
-    
-    double incSlope = CALCSLOPE(inc, prevInc);
-    double phaseSlope = CALCSLOPE(off, prevOff);
-    bool phOffChanged = phaseSlope != 0.f;
-
-    // The maximum distance an impulse can be displaced
-    int jitterWidth = static_cast<int>(jitterFracIn * unit->mImpulseHeap.maxSize);
-
-    // Zero out the output buffer
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        out[xxn] = 0.f;
-    }
-
-    // Update the impulse table indices
-    for (int xxn = 1; xxn < unit->mImpulseHeap.size; xxn++) {
-        unit->mImpulseHeap.heap[xxn] -= inNumSamples;
-    }
+        numPending = numKept;
 
-    // Retrieve impulses for this block
-    while (heapPeek(&unit->mImpulseHeap) < inNumSamples && unit->mImpulseHeap.size > 1) {
-        out[heapPop(&unit->mImpulseHeap)] = 1.f;
-    }
-
-    RGET
-    for (int xxn = 0; xxn < inNumSamples; xxn++) {
-        float impulseResult = testWrapPhase(prevInc, phase);
-        if (impulseResult > 0.5f) {
-            int idx = rgen.irand(jitterWidth) + xxn;
+        impulseBankForEachImpulse(bank, k, inNumSamples, [&](int xxn) {
+            uint32 rand[4];
+            philox(rng->mKey, rng->mCounter++, 0, rand);
+            int idx = rngInt(rand[0], jitterWidth) + xxn;
             if (idx < inNumSamples) {
-                out[idx] = 1.f;
-            } else if (unit->mImpulseHeap.size < heapEffectiveSize) {
-                heapInsert(&unit->mImpulseHeap, idx);
+                out[idx] += 1.f;
+            } else if (numPending < BANK_MAX_PENDING) {
+                pending[numPending++] = idx - inNumSamples;
             }
-        }
-        if (phOffChanged) {
-            phase += phaseSlope;
-            testWrapPhase(prevInc, phase);
-        }
-        prevInc += incSlope;
-        phase += prevInc;
+        });
+        unit->mNumPending[k] = numPending;
     }
-
-    unit->mPhase = phase;
-    unit->mPhaseOffset = off;
-    unit->mPhaseIncrement = inc;
 }
 
-// Construct the ImpulseJitter
-void ImpulseJitter_Ctor(ImpulseJitter* unit) {
-    unit->mPhaseIncrement = IN0(0) * unit->mFreqMul;
-    unit->mPhaseOffset = IN0(1);
+// Construct the ImpulseJitterBank
+void ImpulseJitterBank_Ctor(ImpulseJitterBank* unit) {
+    int numStreams = unit->mNumInputs / 3;
     unit->mFreqMul = static_cast<float>(unit->mRate->mSampleDur);
-    unit->mImpulseHeap.maxSize = HEAP_MAX_SIZE;  // hard coded for now
-    unit->mImpulseHeap.size = 1;
-    unit->mImpulseHeap.heap = (int*)RTAlloc(unit->mWorld, HEAP_MAX_SIZE * sizeof(int));
-
-    double initOff = unit->mPhaseOffset;
-    double initInc = unit->mPhaseIncrement;
-    double initPhase = sc_wrap(initOff, 0.0, 1.0);
-
-    // Initial phase offset of 0 means output of 1 on first sample.
-    // Set phase to wrap point to trigger impulse on first sample
-    if (initPhase == 0.0 && initInc >= 0.0) {
-        initPhase = 1.0; // positive frequency trigger/wrap position
-    }
-    unit->mPhase = initPhase;
-
-    UnitCalcFunc func;
-    switch (INRATE(0)) {
-    case calc_FullRate:
-        switch (INRATE(1)) {
-        case calc_ScalarRate:
-            func = (UnitCalcFunc)ImpulseJitter_next_ai;
-            //printf("Calc function set to ai\n");
-            break;
-        case calc_BufRate:
-            func = (UnitCalcFunc)ImpulseJitter_next_ak;
-            //printf("Calc function set to ak\n");
-            break;
-        case calc_FullRate:
-            func = (UnitCalcFunc)ImpulseJitter_next_aa;
-            //printf("Calc function set to aa\n");
-            break;
-        }
-        break;
-    case calc_BufRate:
-        if (INRATE(1) == calc_ScalarRate) {
-            func = (UnitCalcFunc)ImpulseJitter_next_ki;
-            //printf("Calc function set to ki\n");
-        } else {
-            func = (UnitCalcFunc)ImpulseJitter_next_kk;
-            //printf("Calc function set to kk\n");
-        }
-        break;
-    case calc_ScalarRate:
-        if (INRATE(1) == calc_ScalarRate) {
-            func = (UnitCalcFunc)ImpulseJitter_next_ki;
-            //printf("Calc function set to ki\n");
-        } else {
-            func = (UnitCalcFunc)ImpulseJitter_next_kk;
-            //printf("Calc function set to kk\n");
-        }
-        break;
+    void* memory = rtMemAlloc(unit, "ImpulseJitterBank", impulseBankSize(numStreams));
+    unit->mPending = (int*)rtMemAlloc(unit, "ImpulseJitterBank", numStreams * (BANK_MAX_PENDING + 1) * sizeof(int));
+    unit->mBank.phase = static_cast<double*>(memory);
+    if (!memory || !unit->mPending) {
+        SETCALC(*ClearUnitOutputs);
+        ClearUnitOutputs(unit, 1);
+        return;
+    }
+    impulseBankInit(&unit->mBank, memory, numStreams);
+    unit->mNumPending = unit->mPending + numStreams * BANK_MAX_PENDING;
+    rngInit(unit, &unit->mRNG, 3 * numStreams);
+    for (int k = 0; k < numStreams; k++) {
+        unit->mNumPending[k] = 0;
+        unit->mBank.inc[k] = IN0(k) * unit->mFreqMul;
+        impulseBankSetPhase(&unit->mBank, k, IN0(numStreams + k));
+    }
+
+    SETCALC(ImpulseJitterBank_next);
+    ImpulseJitterBank_next(unit, 1);
+
+    unit->mRNG.mCounter = 0;
+    for (int k = 0; k < numStreams; k++) {
+        unit->mNumPending[k] = 0;
+        impulseBankSetPhase(&unit->mBank, k, IN0(numStreams + k));
     }
-    unit->mCalcFunc = func;
-    func(unit, 1);
-
-    unit->mPhase = initPhase;
-    unit->mPhaseOffset = initOff;
-    unit->mPhaseIncrement = initInc;
 }
 
-void ImpulseJitter_Dtor(ImpulseJitter* unit) {
-    RTFree(unit->mWorld, unit->mImpulseHeap.heap);
+void ImpulseJitterBank_Dtor(ImpulseJitterBank* unit) {
+    rtMemFree(unit->mWorld, unit->mBank.phase);
+    rtMemFree(unit->mWorld, unit->mPending);
 }
 
 PluginLoad(ImpulseJitter) {
     ft = inTable;
+    profileInit(ft, "ImpulseJitter");
+    rtMemInit(ft, "ImpulseJitter");
+    impulseBankAdvance_select(cpuDetectLevel());
+    blitTableInit();
     DefineDtorUnit(ImpulseJitter);
+    DefineDtorUnit(ImpulseJitterBank);
 }
\ No newline at end of file
@@ -24,12 +24,38 @@
 // ImpulseJitter is a version of Impulse that allows the addition of jitter to each impulse.
 ImpulseJitter : UGen {
     *ar {
-        arg freq = 440.0, phase = 0.0, jitterFrac = 0.0, mul = 1.0, add = 0.0;
-        ^this.multiNew('audio', freq, phase, jitterFrac).madd(mul, add);
+        arg freq = 440.0, phase = 0.0, jitterFrac = 0.0, mul = 1.0, add = 0.0, bandLimit = 0, seed = -1;
+        ^this.multiNew('audio', freq, phase, jitterFrac, bandLimit, seed).madd(mul, add);
     }
     *kr {
-        arg freq = 440.0, phase = 0.0, jitterFrac = 0.0, mul = 1.0, add = 0.0;
-        ^this.multiNew('control', freq, phase, jitterFrac).madd(mul, add);
+        arg freq = 440.0, phase = 0.0, jitterFrac = 0.0, mul = 1.0, add = 0.0, bandLimit = 0, seed = -1;
+        ^this.multiNew('control', freq, phase, jitterFrac, bandLimit, seed).madd(mul, add);
+    }
+    signalRange { ^\unipolar }
+}
+
+// ImpulseJitterBank runs many ImpulseJitter streams in a single UGen.
+// Each stream has its own frequency, initial phase and jitter fraction.
+// If mix is true, the streams are summed to a single output channel.
+ImpulseJitterBank : MultiOutUGen {
+    *ar {
+        arg freqs = #[440.0], phases = 0.0, jitterFracs = 0.0, mix = false, mul = 1.0, add = 0.0, seed = -1;
+        ^this.newBank('audio', freqs, phases, jitterFracs, mix, seed).madd(mul, add);
+    }
+    *kr {
+        arg freqs = #[440.0], phases = 0.0, jitterFracs = 0.0, mix = false, mul = 1.0, add = 0.0, seed = -1;
+        ^this.newBank('control', freqs, phases, jitterFracs, mix, seed).madd(mul, add);
+    }
+    *newBank {
+        arg rate, freqs, phases, jitterFracs, mix, seed;
+        var numStreams = freqs.asArray.size;
+        ^this.new1(rate, numStreams, mix, *(freqs.asArray ++ phases.asArray.wrapExtend(numStreams)
+            ++ jitterFracs.asArray.wrapExtend(numStreams) ++ [seed]));
+    }
+    init {
+        arg numStreams, mix ... theInputs;
+        inputs = theInputs;
+        ^this.initOutputs(if(mix, 1, numStreams), rate);
     }
     signalRange { ^\unipolar }
 }
@@ -0,0 +1,60 @@
+/*
+File: ImpulseJitterDropout.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the ImpulseJitterDropout UGen implementation.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SC_PlugIn.h"
+#include "impulseengine.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#include "rtmem.hpp"
+
+static InterfaceTable *ft;
+
+// Represents an ImpulseJitterDropout UGen. Each impulse is first subject to dropout,
+// and the impulses that remain are jittered.
+struct ImpulseJitterDropout : public ImpulseHeapUnit {};
+
+// Construct the ImpulseJitterDropout
+void ImpulseJitterDropout_Ctor(ImpulseJitterDropout* unit) {
+    unit->mImpulseHeap.maxSize = HEAP_MAX_SIZE;  // hard coded for now
+    unit->mImpulseHeap.size = 1;
+    unit->mImpulseHeap.heap = (int*)rtMemAlloc(unit, "ImpulseJitterDropout", HEAP_MAX_SIZE * sizeof(int));
+    if (!unit->mImpulseHeap.heap) {
+        SETCALC(*ClearUnitOutputs);
+        ClearUnitOutputs(unit, 1);
+        return;
+    }
+    impulseEngineCtor<ImpulseJitterDropout, Dropout<3>, Jitter<2>, 4, 5>(unit);
+}
+
+void ImpulseJitterDropout_Dtor(ImpulseJitterDropout* unit) {
+    rtMemFree(unit->mWorld, unit->mImpulseHeap.heap);
+}
+
+PluginLoad(ImpulseJitterDropout) {
+    ft = inTable;
+    profileInit(ft, "ImpulseJitterDropout");
+    rtMemInit(ft, "ImpulseJitterDropout");
+    blitTableInit();
+    DefineDtorUnit(ImpulseJitterDropout);
+}
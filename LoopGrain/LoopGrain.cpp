@@ -0,0 +1,332 @@
+/*
+File: LoopGrain.cpp
+Author: Jeff Martin
+
+Description:
+This is a SuperCollider UGen that plays a buffer with overlapping windowed grains.
+The grains are read from a playhead that moves like a LoopPhasor, with the same triggers,
+loop region and finish behavior. Since the playhead and the grains move at separate rates,
+the speed of playback and the pitch can be set independently, and the overlap of the grains
+smooths the seam where the loop wraps. This replaces a LoopPhasor with several BufRds,
+window envelopes and TGrains in one UGen.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SC_PlugIn.h"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#include "counterrng.hpp"
+#include <cmath>
+
+static InterfaceTable *ft;
+
+// The number of points in the window table. Grains read it with linear interpolation.
+#define LOOPGRAIN_WINDOW_SIZE 2048
+// The number of grains a LoopGrain can play at once. The overlap is limited to one less,
+// so the pool only runs out if the grain duration grows quickly.
+#define LOOPGRAIN_MAX_GRAINS 32
+// The shortest grain in samples
+#define LOOPGRAIN_MIN_GRAIN 4
+
+// The inputs of a LoopGrain
+#define LOOPGRAIN_BUFNUM 0
+#define LOOPGRAIN_TRIG_START 1
+#define LOOPGRAIN_TRIG_END 2
+#define LOOPGRAIN_RATE 3
+#define LOOPGRAIN_PITCH 4
+#define LOOPGRAIN_START 5
+#define LOOPGRAIN_END 6
+#define LOOPGRAIN_LOOP_START 7
+#define LOOPGRAIN_LOOP_END 8
+#define LOOPGRAIN_GRAIN_DUR 9
+#define LOOPGRAIN_OVERLAP 10
+#define LOOPGRAIN_JITTER 11
+#define LOOPGRAIN_SEED 12
+
+// A Hann window, with a guard point at the end so that interpolation never reads past it.
+// It is computed once in PluginLoad and shared by every LoopGrain.
+static float gLoopGrainWindow[LOOPGRAIN_WINDOW_SIZE + 1];
+
+// Represents a grain. Each grain reads the buffer from where the playhead was when it started.
+struct LoopGrainGrain {
+    double mPos;         // read position in frames
+    double mInc;         // read increment in frames per sample
+    double mWinPhase;    // position in the window table
+    double mWinInc;      // window table increment per sample
+    float mAmp;          // amplitude that compensates for the overlap
+    int mSamplesLeft;    // number of samples before the grain ends
+    int mOffset;         // sample of the current block on which the grain starts
+};
+
+// Represents a LoopGrain UGen.
+struct LoopGrain : public Unit {
+    float m_fbufnum;
+    SndBuf* m_buf;
+    double m_level;             // position of the playhead between `start` and `end`, as in LoopPhasor
+    float m_prevTriggerStart;   // previous value of trigger to return to start position
+    float m_prevTriggerFinish;  // previous value of trigger to finish
+    bool m_triggerFinishState;  // current state of finish trigger (true - finish; false - continue looping)
+    double m_countdown;         // number of samples until the next grain starts
+    int m_numGrains;            // number of grains playing, which are the first m_numGrains of m_grains
+    CounterRNG m_rng;           // draws the jitter of the grain positions
+    LoopGrainGrain m_grains[LOOPGRAIN_MAX_GRAINS];
+};
+
+static void LoopGrain_next(LoopGrain* unit, int inNumSamples);
+static void LoopGrain_Ctor(LoopGrain* unit);
+
+// Fills the window table
+static void LoopGrain_initWindow() {
+    for (int i = 0; i <= LOOPGRAIN_WINDOW_SIZE; i++) {
+        gLoopGrainWindow[i] = static_cast<float>(0.5 - 0.5 * std::cos(twopi * i / LOOPGRAIN_WINDOW_SIZE));
+    }
+}
+
+// 4-point, 3rd-order Hermite interpolation between y1 and y2
+static inline float LoopGrain_cubic(float x, float y0, float y1, float y2, float y3) {
+    float c1 = 0.5f * (y2 - y0);
+    float c2 = y0 - 2.5f * y1 + 2.f * y2 - 0.5f * y3;
+    float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+    return ((c3 * x + c2) * x + c1) * x + y1;
+}
+
+// Reads a sample of a channel, or 0 if the frame is outside the buffer
+static inline float LoopGrain_sample(const float* bufData, int bufFrames, int numChannels, int frame, int channel) {
+    return (frame >= 0 && frame < bufFrames) ? bufData[frame * numChannels + channel] : 0.f;
+}
+
+// Adds count samples of a grain to the outputs, starting at sample offset of the block
+static void LoopGrain_render(LoopGrainGrain* grain, const float* bufData, int bufFrames, int numChannels,
+    float** outs, int offset, int count) {
+    double pos = grain->mPos;
+    double inc = grain->mInc;
+    double winPhase = grain->mWinPhase;
+    double winInc = grain->mWinInc;
+    float amp = grain->mAmp;
+
+    // If every read of this chunk has all four of its frames inside the buffer, the bounds checks
+    // can be left out. Otherwise frames outside the buffer are read as silence.
+    double lastPos = pos + inc * (count - 1);
+    if (sc_min(pos, lastPos) >= 1.0 && sc_max(pos, lastPos) < bufFrames - 3) {
+        for (int xxn = 0; xxn < count; xxn++) {
+            int iwin = static_cast<int>(winPhase);
+            float winFrac = static_cast<float>(winPhase - iwin);
+            float window = amp * (gLoopGrainWindow[iwin] + winFrac * (gLoopGrainWindow[iwin + 1] - gLoopGrainWindow[iwin]));
+            int ipos = static_cast<int>(pos);
+            float frac = static_cast<float>(pos - ipos);
+            const float* frame = bufData + (ipos - 1) * numChannels;
+            for (int ch = 0; ch < numChannels; ch++) {
+                outs[ch][offset + xxn] += window * LoopGrain_cubic(frac, frame[ch], frame[ch + numChannels],
+                    frame[ch + 2 * numChannels], frame[ch + 3 * numChannels]);
+            }
+            pos += inc;
+            winPhase += winInc;
+        }
+    } else {
+        for (int xxn = 0; xxn < count; xxn++) {
+            int iwin = static_cast<int>(winPhase);
+            float winFrac = static_cast<float>(winPhase - iwin);
+            float window = amp * (gLoopGrainWindow[iwin] + winFrac * (gLoopGrainWindow[iwin + 1] - gLoopGrainWindow[iwin]));
+            double floorPos = std::floor(pos);
+            int ipos = static_cast<int>(floorPos);
+            float frac = static_cast<float>(pos - floorPos);
+            for (int ch = 0; ch < numChannels; ch++) {
+                outs[ch][offset + xxn] += window * LoopGrain_cubic(frac,
+                    LoopGrain_sample(bufData, bufFrames, numChannels, ipos - 1, ch),
+                    LoopGrain_sample(bufData, bufFrames, numChannels, ipos, ch),
+                    LoopGrain_sample(bufData, bufFrames, numChannels, ipos + 1, ch),
+                    LoopGrain_sample(bufData, bufFrames, numChannels, ipos + 2, ch));
+            }
+            pos += inc;
+            winPhase += winInc;
+        }
+    }
+
+    grain->mPos = pos;
+    grain->mWinPhase = winPhase;
+}
+
+// Construct the LoopGrain
+void LoopGrain_Ctor(LoopGrain* unit) {
+    SETCALC(LoopGrain_next);
+
+    // Force a buffer lookup on the first block
+    unit->m_fbufnum = -1e9f;
+    unit->m_buf = nullptr;
+
+    // Initialize the triggers
+    unit->m_prevTriggerStart = IN0(LOOPGRAIN_TRIG_START);
+    unit->m_prevTriggerFinish = IN0(LOOPGRAIN_TRIG_END);
+    unit->m_triggerFinishState = false;
+
+    // Initialize the playhead. The first grain starts on the first sample.
+    unit->m_level = IN0(LOOPGRAIN_START);
+    unit->m_countdown = 0.0;
+    unit->m_numGrains = 0;
+    rngInit(unit, &unit->m_rng, LOOPGRAIN_SEED);
+
+    ClearUnitOutputs(unit, 1);
+}
+
+// Calculates samples for a LoopGrain.ar UGen
+void LoopGrain_next(LoopGrain* unit, int inNumSamples) {
+    GET_BUF_SHARED
+    int numChannels = static_cast<int>(unit->mNumOutputs);
+    if (!bufData || static_cast<int>(bufChannels) != numChannels) {
+        ClearUnitOutputs(unit, inNumSamples);
+        return;
+    }
+
+    // The triggers, rate and pitch may be audio or control rate. A step of 0 reads the control value on every sample.
+    const float* triggerReturnToStart = IN(LOOPGRAIN_TRIG_START);
+    const float* triggerFinish = IN(LOOPGRAIN_TRIG_END);
+    const float* rate = IN(LOOPGRAIN_RATE);
+    const float* pitch = IN(LOOPGRAIN_PITCH);
+    int triggerReturnToStartStep = INRATE(LOOPGRAIN_TRIG_START) == calc_FullRate ? 1 : 0;
+    int triggerFinishStep = INRATE(LOOPGRAIN_TRIG_END) == calc_FullRate ? 1 : 0;
+    int rateStep = INRATE(LOOPGRAIN_RATE) == calc_FullRate ? 1 : 0;
+    int pitchStep = INRATE(LOOPGRAIN_PITCH) == calc_FullRate ? 1 : 0;
+
+    // Get new parameters of the LoopGrain
+    double startPosition = IN0(LOOPGRAIN_START);
+    double endPosition = IN0(LOOPGRAIN_END);
+    double loopStart = IN0(LOOPGRAIN_LOOP_START);
+    double loopEnd = IN0(LOOPGRAIN_LOOP_END);
+    int grainSamples = sc_max(static_cast<int>(IN0(LOOPGRAIN_GRAIN_DUR) * SAMPLERATE), LOOPGRAIN_MIN_GRAIN);
+    double overlap = sc_clip(static_cast<double>(IN0(LOOPGRAIN_OVERLAP)), 1.0, LOOPGRAIN_MAX_GRAINS - 1.0);
+    double interval = sc_max(grainSamples / overlap, 1.0);
+    // Hann windows overlapping by more than 2 sum to overlap / 2
+    float amp = static_cast<float>(sc_min(1.0, 2.0 / overlap));
+    double winInc = static_cast<double>(LOOPGRAIN_WINDOW_SIZE) / grainSamples;
+    // Pitch 1 plays the buffer at its own sample rate
+    double rateScale = buf->samplerate * SAMPLEDUR;
+    // Grains start up to half of the jitter times the grain duration away from the playhead, in frames
+    double jitterWidth = sc_clip(static_cast<double>(IN0(LOOPGRAIN_JITTER)), 0.0, 1.0) * grainSamples * rateScale;
+    CounterRNG* rng = &unit->m_rng;
+
+    // Get current state of the LoopGrain
+    float previousTriggerReturnToStart = unit->m_prevTriggerStart;
+    float previousTriggerFinish = unit->m_prevTriggerFinish;
+    double level = unit->m_level;
+    double countdown = unit->m_countdown;
+    bool finished = false;
+
+    // Move the playhead as a LoopPhasor does, and start grains from it
+    for (int xxn = 0; xxn < inNumSamples; xxn++) {
+        float trigStart = triggerReturnToStart[xxn * triggerReturnToStartStep];
+        float trigEnd = triggerFinish[xxn * triggerFinishStep];
+        double currentRate = rate[xxn * rateStep];
+
+        // Handle trigger return to start. The next grain starts at the new position.
+        if (previousTriggerReturnToStart <= 0.f && trigStart > 0.f) {
+            if (triggerReturnToStartStep) {
+                float frac = 1.f - previousTriggerReturnToStart / (trigStart - previousTriggerReturnToStart);
+                level = startPosition + frac * currentRate;
+            } else {
+                level = startPosition;
+            }
+            countdown = 0.0;
+        }
+
+        // Handle trigger finish. This just flips the finish trigger.
+        if (previousTriggerFinish <= 0.f && trigEnd > 0.f) {
+            unit->m_triggerFinishState = !(unit->m_triggerFinishState);
+        }
+
+        // Wrapping: if we haven't triggered completion
+        if (!unit->m_triggerFinishState) {
+            // If we're inside the looping part of the LoopGrain
+            if (level >= loopStart && level <= loopEnd) {
+                level = sc_wrap(level, loopStart, loopEnd);
+            } else {
+                level = sc_wrap(level, startPosition, endPosition);
+            }
+            finished = false;
+        }
+
+        // Wrapping: if we have triggered completion. No more grains start once the playhead stops.
+        else {
+            level = sc_max(level, startPosition);
+            level = sc_min(level, endPosition);
+            finished = currentRate >= 0.0 ? level >= endPosition : level <= startPosition;
+        }
+
+        // Start a grain. If the pool is full, the grain is dropped. Jittering the positions keeps grains
+        // that read the same material out of step from canceling when the playhead is slower than the grains.
+        if (!finished) {
+            countdown -= 1.0;
+            if (countdown <= 0.0) {
+                countdown += interval;
+                if (unit->m_numGrains < LOOPGRAIN_MAX_GRAINS) {
+                    uint32 rand[4];
+                    philox(rng->mKey, rng->mCounter++, 0, rand);
+                    LoopGrainGrain* grain = &unit->m_grains[unit->m_numGrains++];
+                    grain->mPos = level + (rngUniform(rand[0]) - 0.5f) * jitterWidth;
+                    grain->mInc = pitch[xxn * pitchStep] * rateScale;
+                    grain->mWinPhase = 0.0;
+                    grain->mWinInc = winInc;
+                    grain->mAmp = amp;
+                    grain->mSamplesLeft = grainSamples;
+                    grain->mOffset = xxn;
+                }
+            }
+        } else {
+            countdown = 0.0;
+        }
+
+        level += currentRate;
+        previousTriggerReturnToStart = trigStart;
+        previousTriggerFinish = trigEnd;
+    }
+
+    // Update the state of the LoopGrain
+    unit->m_prevTriggerStart = previousTriggerReturnToStart;
+    unit->m_prevTriggerFinish = previousTriggerFinish;
+    unit->m_level = level;
+    unit->m_countdown = countdown;
+
+    // Render the grains. A grain that ends is replaced by the last one in the pool.
+    for (int ch = 0; ch < numChannels; ch++) {
+        Clear(inNumSamples, OUT(ch));
+    }
+    int grainIndex = 0;
+    while (grainIndex < unit->m_numGrains) {
+        LoopGrainGrain* grain = &unit->m_grains[grainIndex];
+        int count = sc_min(grain->mSamplesLeft, inNumSamples - grain->mOffset);
+        LoopGrain_render(grain, bufData, static_cast<int>(bufFrames), numChannels, unit->mOutBuf, grain->mOffset, count);
+        grain->mSamplesLeft -= count;
+        grain->mOffset = 0;
+        if (grain->mSamplesLeft <= 0) {
+            *grain = unit->m_grains[--unit->m_numGrains];
+        } else {
+            grainIndex++;
+        }
+    }
+
+    // The LoopGrain is done once it has finished and the last grain has faded out
+    if (finished && unit->m_numGrains == 0) {
+        unit->mDone = true;
+    }
+}
+
+PluginLoad(LoopGrain) {
+    ft = inTable;
+    profileInit(ft, "LoopGrain");
+    LoopGrain_initWindow();
+    DefineSimpleUnit(LoopGrain);
+}
@@ -0,0 +1,41 @@
+// File: LoopGrain.sc
+// Author: Jeff Martin
+//
+// Description:
+// This is a SuperCollider UGen that plays a buffer with overlapping windowed grains.
+// The grains are read from a playhead that moves like a LoopPhasor.
+//
+// Copyright © 2026 by Jeffrey Martin. All rights reserved.
+// Website: https://www.jeffreymartincomposer.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// LoopGrain combines a LoopPhasor with a granular player:
+// 1. The playhead has the same triggers, loop region and finish behavior as LoopPhasor.
+// 2. Grains start from the playhead at regular intervals. The playhead rate sets the speed of
+//    playback and the pitch sets the transposition of the grains, so the two are independent.
+LoopGrain : MultiOutUGen {
+    *ar { arg numChannels = 1, bufnum = 0, trigStart = 0.0, trigEnd = 0.0, rate = 1.0, pitch = 1.0, start = 0.0, end = 1.0,
+        loopStart = 0.0, loopEnd = 1.0, grainDur = 0.1, overlap = 4.0, jitter = 0.0, mul = 1.0, add = 0.0, seed = -1;
+        ^this.multiNew('audio', numChannels, bufnum, trigStart, trigEnd, rate, pitch, start, end,
+            loopStart, loopEnd, grainDur, overlap, jitter, seed).madd(mul, add);
+    }
+
+    init { arg argNumChannels ... theInputs;
+        inputs = theInputs;
+        ^this.initOutputs(argNumChannels, rate);
+    }
+
+    argNamesInputsOffset { ^2 }
+}
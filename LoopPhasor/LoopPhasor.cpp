@@ -25,6 +25,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "SC_PlugIn.h"
+#include "profile.hpp"
+#include "rtcheck.hpp"
 
 static InterfaceTable *ft;
 
@@ -43,14 +45,15 @@ static void LoopPhasor_Ctor(LoopPhasor* unit);
 
 // Construct the LoopPhasor
 void LoopPhasor_Ctor(LoopPhasor* unit) {
-    // Set the calculation function 
+    // Set the calculation function. If either trigger or the rate is at audio rate, the _aa and _ak
+    // functions follow it sample by sample, and read the other triggers with a step of 0. _aa also
+    // reads the rate sample by sample. Only with no audio-rate input does _kk handle the triggers
+    // once per block.
     if (unit->mCalcRate == calc_FullRate) {
-        if (INRATE(0) == calc_FullRate) {
-            if (INRATE(1) == calc_FullRate) {
-                SETCALC(LoopPhasor_next_aa);
-            } else {
-                SETCALC(LoopPhasor_next_ak);
-            }
+        if (INRATE(2) == calc_FullRate) {
+            SETCALC(LoopPhasor_next_aa);
+        } else if (INRATE(0) == calc_FullRate || INRATE(1) == calc_FullRate) {
+            SETCALC(LoopPhasor_next_ak);
         } else {
             SETCALC(LoopPhasor_next_kk);
         }
@@ -131,8 +134,11 @@ void LoopPhasor_next_ak(LoopPhasor* unit, int inNumSamples) {
     float* out = OUT(0);
 
     // Get new parameters of the LoopPhasor
+    // The triggers may be audio or control rate. A step of 0 reads the control value on every sample.
     float *triggerReturnToStart = IN(0);
     float *triggerFinish = IN(1);
+    int triggerReturnToStartStep = INRATE(0) == calc_FullRate ? 1 : 0;
+    int triggerFinishStep = INRATE(1) == calc_FullRate ? 1 : 0;
     double rate = IN0(2);
     double startPosition = IN0(3);
     double endPosition = IN0(4);
@@ -147,13 +153,17 @@ void LoopPhasor_next_ak(LoopPhasor* unit, int inNumSamples) {
     // Compute output block
     for (int xxn = 0; xxn < inNumSamples; xxn++) {
         // If we reset to start
-        if (previousTriggerReturnToStart <= 0.f && triggerReturnToStart[xxn] > 0.f) {
-            float frac = 1.f - previousTriggerReturnToStart / (triggerReturnToStart[xxn] - previousTriggerReturnToStart);
+        float trigStart = triggerReturnToStart[xxn * triggerReturnToStartStep];
+        float trigFinish = triggerFinish[xxn * triggerFinishStep];
+        if (previousTriggerReturnToStart <= 0.f && trigStart > 0.f) {
+            // A control-rate trigger jumps to start itself, as it does in _kk
+            float frac = triggerReturnToStartStep
+                ? 1.f - previousTriggerReturnToStart / (trigStart - previousTriggerReturnToStart) : 0.f;
             level = startPosition + frac * rate;
         }
 
         // Handle trigger finish. This just flips the finish trigger.
-        if (previousTriggerFinish <= 0.f && triggerFinish[xxn] > 0.f) {
+        if (previousTriggerFinish <= 0.f && trigFinish > 0.f) {
             unit->m_triggerFinishState = !(unit->m_triggerFinishState);
         }
 
@@ -175,8 +185,8 @@ void LoopPhasor_next_ak(LoopPhasor* unit, int inNumSamples) {
 
         out[xxn] = static_cast<float>(level);
         level += rate;
-        previousTriggerReturnToStart = triggerReturnToStart[xxn];
-        previousTriggerFinish = triggerFinish[xxn];
+        previousTriggerReturnToStart = trigStart;
+        previousTriggerFinish = trigFinish;
     }
 
     // update the state of the LoopPhasor
@@ -190,8 +200,11 @@ void LoopPhasor_next_aa(LoopPhasor* unit, int inNumSamples) {
     float* out = OUT(0);
 
     // Get new parameters of the LoopPhasor
+    // The triggers may be audio or control rate. A step of 0 reads the control value on every sample.
     float *triggerReturnToStart = IN(0);
     float *triggerFinish = IN(1);
+    int triggerReturnToStartStep = INRATE(0) == calc_FullRate ? 1 : 0;
+    int triggerFinishStep = INRATE(1) == calc_FullRate ? 1 : 0;
     float *rate = IN(2);
     double startPosition = IN0(3);
     double endPosition = IN0(4);
@@ -203,19 +216,20 @@ void LoopPhasor_next_aa(LoopPhasor* unit, int inNumSamples) {
     float previousTriggerFinish = unit->m_prevTriggerFinish;
     double level = unit->m_level;
 
-    float *in = triggerReturnToStart;
-    float previn = previousTriggerReturnToStart;
-
     // Compute output block
     for (int xxn = 0; xxn < inNumSamples; xxn++) {
         // Handle trigger return to start
-        if (previousTriggerReturnToStart <= 0.f && triggerReturnToStart[xxn] > 0.f) {
-            float frac = 1.f - previousTriggerReturnToStart / (triggerReturnToStart[xxn] - previousTriggerReturnToStart);
+        float trigStart = triggerReturnToStart[xxn * triggerReturnToStartStep];
+        float trigFinish = triggerFinish[xxn * triggerFinishStep];
+        if (previousTriggerReturnToStart <= 0.f && trigStart > 0.f) {
+            // A control-rate trigger jumps to start itself, as it does in _kk
+            float frac = triggerReturnToStartStep
+                ? 1.f - previousTriggerReturnToStart / (trigStart - previousTriggerReturnToStart) : 0.f;
             level = startPosition + frac * rate[xxn];
         }
 
         // Handle trigger finish. This just flips the finish trigger.
-        if (previousTriggerFinish <= 0.f && triggerFinish[xxn] > 0.f) {
+        if (previousTriggerFinish <= 0.f && trigFinish > 0.f) {
             unit->m_triggerFinishState = !(unit->m_triggerFinishState);
         }
 
@@ -237,8 +251,8 @@ void LoopPhasor_next_aa(LoopPhasor* unit, int inNumSamples) {
         
         out[xxn] = static_cast<float>(level);
         level += rate[xxn];
-        previousTriggerReturnToStart = triggerReturnToStart[xxn];
-        previousTriggerFinish = triggerFinish[xxn];
+        previousTriggerReturnToStart = trigStart;
+        previousTriggerFinish = trigFinish;
     }
     
     // update the state of the LoopPhasor at the end of the calculation block
@@ -249,5 +263,6 @@ void LoopPhasor_next_aa(LoopPhasor* unit, int inNumSamples) {
 
 PluginLoad(LoopPhasor) {
     ft = inTable;
+    profileInit(ft, "LoopPhasor");
     DefineSimpleUnit(LoopPhasor);
 }
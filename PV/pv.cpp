@@ -26,8 +26,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "SC_InterfaceTable.h"
 #include "FFT_UGens.h"
 #include "SC_Unit.h"
+#include "counterrng.hpp"
+#include "pvkernels.hpp"
+#include "denormal.hpp"
+#include "rtmem.hpp"
+#include "scratch.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
 
-InterfaceTable *ft;
+static InterfaceTable *ft;
 
 struct PV_CFreeze : public Unit {
     int mNumBins;    // The number of FFT bins
@@ -38,6 +45,7 @@ struct PV_CFreeze : public Unit {
     float *mPhase;   // The most recent phase array
     float *mPhaseDiffs;  // The 2D array of FFT phase differences
     size_t mWritePtr;   // The write pointer
+    CounterRNG mRNG;    // The seedable random number generator
 };
 
 struct PV_BinRandomMask : public Unit {
@@ -45,6 +53,7 @@ struct PV_BinRandomMask : public Unit {
     bool mDcMask, mNyqMask;  // The masks for DC and Nyquist
     float mTrig;             // The trigger for recomputing the mask
     int mNumBins;            // The number of FFT bins
+    CounterRNG mRNG;         // The seedable random number generator
 };
 
 struct PV_MagSqueeze : public Unit {};
@@ -55,27 +64,45 @@ struct PV_MagMirror : public Unit {};
 
 struct PV_MagXFade : public Unit {};
 
+static void PV_CFreeze_Dtor(PV_CFreeze *unit);
+
+// Every unit here rewrites its first FFT buffer in place. Under supernova, PV_GET_BUF and PV_GET_BUF2
+// take exclusive locks on the buffers, so units in parallel groups that share a chain wait for each other.
+// Each calc function flushes denormals for the frame, and returns early on a silent frame when the
+// result would be the same silent frame.
 static void PV_CFreeze_next(PV_CFreeze *unit, int inNumSamples) {
     PV_GET_BUF
+    DenormalScope denormals;
     float freezeState = IN0(1);
     // allocate the buffers
     if (!unit->mMags) {
         // MxN where N is num bins, and M is num frames. Acts as a circular buffer.
-        unit->mMags = (float*)RTAlloc(unit->mWorld, numbins * sizeof(float) * unit->mNumFrames);
+        unit->mMags = (float*)rtMemAlloc(unit, "PV_CFreeze", numbins * sizeof(float) * unit->mNumFrames);
         // M (num frames)
-        unit->mDc = (float*)RTAlloc(unit->mWorld, sizeof(float) * unit->mNumFrames);
+        unit->mDc = (float*)rtMemAlloc(unit, "PV_CFreeze", sizeof(float) * unit->mNumFrames);
         // M (num frames)
-        unit->mNyq = (float*)RTAlloc(unit->mWorld, sizeof(float) * unit->mNumFrames);
+        unit->mNyq = (float*)rtMemAlloc(unit, "PV_CFreeze", sizeof(float) * unit->mNumFrames);
         // N (num bins)
-        unit->mPhase = (float*)RTAlloc(unit->mWorld, numbins * sizeof(float));
+        unit->mPhase = (float*)rtMemAlloc(unit, "PV_CFreeze", numbins * sizeof(float));
         // MxN where N is num bins, and M is num frames.
         // Acts as a circular buffer corresponding to unit->mMags.
-        unit->mPhaseDiffs = (float*)RTAlloc(unit->mWorld, numbins * sizeof(float) * unit->mNumFrames);
-        ClearFFTUnitIfMemFailed(unit->mMags);
-        ClearFFTUnitIfMemFailed(unit->mDc);
-        ClearFFTUnitIfMemFailed(unit->mNyq);
-        ClearFFTUnitIfMemFailed(unit->mPhase);
-        ClearFFTUnitIfMemFailed(unit->mPhaseDiffs);
+        unit->mPhaseDiffs = (float*)rtMemAlloc(unit, "PV_CFreeze", numbins * sizeof(float) * unit->mNumFrames);
+        bool allocated = unit->mMags && unit->mDc && unit->mNyq && unit->mPhase && unit->mPhaseDiffs;
+        if (!allocated) {
+            // Give back the arrays that were allocated. rtMemAlloc has logged the failure without printing,
+            // and the unit outputs silence from now on.
+            PV_CFreeze_Dtor(unit);
+            SETCALC(*ClearUnitOutputs);
+            ClearUnitOutputs(unit, inNumSamples);
+            unit->mDone = true;
+            return;
+        }
+        // Start from silence, so that freezing before the history fills does not replay garbage or NaNs
+        memset(unit->mMags, 0, numbins * sizeof(float) * unit->mNumFrames);
+        memset(unit->mDc, 0, sizeof(float) * unit->mNumFrames);
+        memset(unit->mNyq, 0, sizeof(float) * unit->mNumFrames);
+        memset(unit->mPhase, 0, numbins * sizeof(float));
+        memset(unit->mPhaseDiffs, 0, numbins * sizeof(float) * unit->mNumFrames);
         unit->mNumBins = numbins;
         unit->mWritePtr = 0;
     } else if (numbins != unit->mNumBins) {
@@ -83,16 +110,40 @@ static void PV_CFreeze_next(PV_CFreeze *unit, int inNumSamples) {
         return;
     }
 
+    if (freezeState <= 0.f && pvFrameIsSilent(buf, numbins)) {
+        // Record a silent frame without converting it. Its phases are 0.
+        float *currentMagArr = unit->mMags + (unit->mWritePtr * unit->mNumBins);
+        float *currentPhaseDiffArr = unit->mPhaseDiffs + (unit->mWritePtr * unit->mNumBins);
+        for (int xxn = 0; xxn < numbins; xxn++) {
+            currentMagArr[xxn] = 0.f;
+            currentPhaseDiffArr[xxn] = sc_wrap(-unit->mPhase[xxn], 0.f, static_cast<float>(twopi));
+            unit->mPhase[xxn] = 0.f;
+        }
+        unit->mDc[unit->mWritePtr] = 0.f;
+        unit->mNyq[unit->mWritePtr] = 0.f;
+        unit->mWritePtr++;
+        unit->mWritePtr %= unit->mNumFrames;
+        return;
+    }
+
     SCPolarBuf *p = ToPolarApx(buf);
 
     if (freezeState > 0.f) {
-        RGET
+        // Draw all of the random values for the frame at once, one per bin plus DC and Nyquist
+        ScratchScope scratch(unit);
+        float *rand = scratch.alloc<float>(numbins + 2);
+        if (!rand) {
+            // Out of memory for this frame only, so pass no frame on
+            OUT0(0) = -1.f;
+            return;
+        }
+        rngFill(&unit->mRNG, rand, numbins + 2);
         // Pull random DC and nyquist magnitudes
-        p->dc = unit->mDc[rgen.irand(unit->mNumFrames)];
-        p->nyq = unit->mNyq[rgen.irand(unit->mNumFrames)];
+        p->dc = unit->mDc[rngScale(rand[numbins], unit->mNumFrames)];
+        p->nyq = unit->mNyq[rngScale(rand[numbins + 1], unit->mNumFrames)];
         for (int xxn = 0; xxn < unit->mNumBins; xxn++) {
             // For each bin, grab a random magnitude and phase diff pair
-            int idx = rgen.irand(unit->mNumFrames);
+            int idx = rngScale(rand[xxn], unit->mNumFrames);
             idx = idx * unit->mNumBins + xxn;
             p->bin[xxn].mag = unit->mMags[idx];
             unit->mPhase[xxn] = sc_wrap(unit->mPhase[xxn] + unit->mPhaseDiffs[idx], 0.f, static_cast<float>(twopi));
@@ -122,36 +173,45 @@ static void PV_CFreeze_Ctor(PV_CFreeze *unit) {
     unit->mNyq = nullptr;
     unit->mPhase = nullptr;
     unit->mPhaseDiffs = nullptr;
+    rngInit(unit, &unit->mRNG, 3);
     int numFrames = IN0(2);
     // prevent the user from doing something nuts
     unit->mNumFrames = sc_wrap(numFrames, 1, 20);
 }
 
 static void PV_CFreeze_Dtor(PV_CFreeze *unit) {
-    if (unit->mMags) {
-        RTFree(unit->mWorld, unit->mMags);
-        unit->mMags = nullptr;
-    }
-    if (unit->mDc) {
-        RTFree(unit->mWorld, unit->mDc);
-        unit->mDc = nullptr;
-    }
-    if (unit->mNyq) {
-        RTFree(unit->mWorld, unit->mNyq);
-        unit->mNyq = nullptr;
-    }
-    if (unit->mPhase) {
-        RTFree(unit->mWorld, unit->mPhase);
-        unit->mPhase = nullptr;
+    rtMemFree(unit->mWorld, unit->mMags);
+    unit->mMags = nullptr;
+    rtMemFree(unit->mWorld, unit->mDc);
+    unit->mDc = nullptr;
+    rtMemFree(unit->mWorld, unit->mNyq);
+    unit->mNyq = nullptr;
+    rtMemFree(unit->mWorld, unit->mPhase);
+    unit->mPhase = nullptr;
+    rtMemFree(unit->mWorld, unit->mPhaseDiffs);
+    unit->mPhaseDiffs = nullptr;
+}
+
+// Draws a new mask. Bins are kept with a probability that falls off with frequency according to expCurve.
+// If there is no memory for the random values, the mask stays as it was.
+static void PV_BinRandomMask_computeMask(PV_BinRandomMask *unit, int numbins, float prob, float expCurve) {
+    // Draw all of the random values for the mask at once, one per bin plus DC and Nyquist
+    ScratchScope scratch(unit);
+    float *rand = scratch.alloc<float>(numbins + 2);
+    if (!rand) {
+        return;
     }
-    if (unit->mPhaseDiffs) {
-        RTFree(unit->mWorld, unit->mPhaseDiffs);
-        unit->mPhaseDiffs = nullptr;
+    rngFill(&unit->mRNG, rand, numbins + 2);
+    for (int xxn = 0; xxn < numbins; xxn++) {
+        unit->mBinMasks[xxn] = !(rand[xxn] > (1.f - prob) * sc_pow(2.f, (xxn + 1) * expCurve));
     }
+    unit->mDcMask = !(rand[numbins] > 1.f - prob);
+    unit->mNyqMask = !(rand[numbins + 1] > (1.f - prob) * sc_pow(2.f, (numbins) * expCurve));
 }
 
 static void PV_BinRandomMask_next(PV_BinRandomMask *unit, int inNumSamples) {
     PV_GET_BUF
+    DenormalScope denormals;
     float mask = IN0(1);
     float prob = IN0(2);
     float expCurve = IN0(3);
@@ -160,50 +220,34 @@ static void PV_BinRandomMask_next(PV_BinRandomMask *unit, int inNumSamples) {
 
     // Initialize mask first time
     if (!unit->mBinMasks) {
-        unit->mBinMasks = (bool*)RTAlloc(unit->mWorld, numbins * sizeof(bool));
+        unit->mBinMasks = (bool*)rtMemAlloc(unit, "PV_BinRandomMask", numbins * sizeof(bool));
+        if (!unit->mBinMasks) {
+            // rtMemAlloc has logged the failure without printing. The unit outputs silence from now on.
+            SETCALC(*ClearUnitOutputs);
+            ClearUnitOutputs(unit, inNumSamples);
+            unit->mDone = true;
+            return;
+        }
         unit->mNumBins = numbins;
-        RGET
+        // Keep every bin until a mask can be drawn
         for (int xxn = 0; xxn < numbins; xxn++) {
-            if (rgen.frand() > (1.f - prob) * sc_pow(2.f, (xxn + 1) * expCurve)) {
-                unit->mBinMasks[xxn] = false;
-            } else {
-                unit->mBinMasks[xxn] = true;
-            }
-        }
-        if (rgen.frand() > 1.f - prob) {
-            unit->mDcMask = false;
-        } else {
-            unit->mDcMask = true;
-        }
-        if (rgen.frand() > (1.f - prob) * sc_pow(2.f, (numbins) * expCurve)) {
-            unit->mNyqMask = false;
-        } else {
-            unit->mNyqMask = true;
+            unit->mBinMasks[xxn] = true;
         }
+        unit->mDcMask = unit->mNyqMask = true;
+        PV_BinRandomMask_computeMask(unit, numbins, prob, expCurve);
     } else if (unit->mNumBins != numbins) {
         return;
     }
 
     // Recompute mask
     if (trig > 0.f && unit->mTrig == 0.f) {
-        RGET
-        for (int xxn = 0; xxn < numbins; xxn++) {
-            if (rgen.frand() > (1.f - prob) * sc_pow(2.f, (xxn + 1) * expCurve)) {
-                unit->mBinMasks[xxn] = false;
-            } else {
-                unit->mBinMasks[xxn] = true;
-            }
-        }
-        if (rgen.frand() > 1.f - prob) {
-            unit->mDcMask = false;
-        } else {
-            unit->mDcMask = true;
-        }
-        if (rgen.frand() > (1.f - prob) * sc_pow(2.f, (numbins) * expCurve)) {
-            unit->mNyqMask = false;
-        } else {
-            unit->mNyqMask = true;
-        }
+        PV_BinRandomMask_computeMask(unit, numbins, prob, expCurve);
+    }
+    unit->mTrig = trig;
+
+    // Masking silence with 0 leaves it silent
+    if (mask == 0.f && pvFrameIsSilent(buf, numbins)) {
+        return;
     }
 
     SCPolarBuf *p = ToPolarApx(buf);
@@ -220,41 +264,43 @@ static void PV_BinRandomMask_next(PV_BinRandomMask *unit, int inNumSamples) {
     if (!unit->mNyqMask) {
         p->nyq = mask;
     }
-    unit->mTrig = trig;
 }
 
 static void PV_BinRandomMask_Ctor(PV_BinRandomMask *unit) {
     SETCALC(PV_BinRandomMask_next);
     unit->mBinMasks = nullptr;
     unit->mTrig = 0.f;
+    rngInit(unit, &unit->mRNG, 5);
     OUT0(0) = IN0(0);
 }
 
 static void PV_BinRandomMask_Dtor(PV_BinRandomMask *unit) {
-    if (unit->mBinMasks) {
-        RTFree(unit->mWorld, unit->mBinMasks);
-        unit->mBinMasks = nullptr;
-    }
+    rtMemFree(unit->mWorld, unit->mBinMasks);
+    unit->mBinMasks = nullptr;
 }
 
 static void PV_MagSqueeze_next(PV_MagSqueeze *unit, int inNumSamples) {
     PV_GET_BUF
+    DenormalScope denormals;
     float low = IN0(1);
     float high = IN0(2);
-    SCPolarBuf *p = ToPolarApx(buf);
-    float min = p->dc;
-    float max = p->dc;
-    if (p->nyq < min)
-        min = p->nyq;
-    if (p->nyq > max)
-        max = p->nyq;
-    for (int i = 0; i < numbins; i++) {
-        if (p->bin[i].mag < min)
-            min = p->bin[i].mag;
-        if (p->bin[i].mag > max)
-            max = p->bin[i].mag;
+    if (low == 0.f && pvFrameIsSilent(buf, numbins)) {
+        return;
     }
+    SCPolarBuf *p = ToPolarApx(buf);
+    float min, max;
+    pvMagRange(p, numbins, &min, &max);
     float range = high - low;
+    if (!(max > 0.f)) {
+        // Every magnitude is 0 (or NaN), so squeeze them all to the bottom of the range rather than
+        // dividing by 0
+        p->dc = low;
+        p->nyq = low;
+        for (int i = 0; i < numbins; i++) {
+            p->bin[i].mag = low;
+        }
+        return;
+    }
     p->dc = (p->dc / max) * range + low;
     p->nyq = (p->nyq / max) * range + low;
     for (int i = 0; i < numbins; i++) {
@@ -269,18 +315,16 @@ static void PV_MagSqueeze_Ctor(PV_MagSqueeze *unit) {
 
 static void PV_MagSqueeze1_next(PV_MagSqueeze1 *unit, int inNumSamples) {
     PV_GET_BUF
+    DenormalScope denormals;
+    if (pvFrameIsSilent(buf, numbins)) {
+        return;
+    }
     SCPolarBuf *p = ToPolarApx(buf);
-    float min = p->dc;
-    float max = p->dc;
-    if (p->nyq < min)
-        min = p->nyq;
-    if (p->nyq > max)
-        max = p->nyq;
-    for (int i = 0; i < numbins; i++) {
-        if (p->bin[i].mag < min)
-            min = p->bin[i].mag;
-        if (p->bin[i].mag > max)
-            max = p->bin[i].mag;
+    float min, max;
+    pvMagRange(p, numbins, &min, &max);
+    if (!(max > 0.f)) {
+        // Nothing to scale by, so the frame is left as it is
+        return;
     }
     float range = max - min;
     p->dc = (p->dc / max) * range + min;
@@ -297,18 +341,16 @@ static void PV_MagSqueeze1_Ctor(PV_MagSqueeze1 *unit) {
 
 static void PV_MagMirror_next(PV_MagMirror *unit, int inNumSamples) {
     PV_GET_BUF
+    DenormalScope denormals;
+    if (pvFrameIsSilent(buf, numbins)) {
+        return;
+    }
     SCPolarBuf *p = ToPolarApx(buf);
-    float min = p->dc;
-    float max = p->dc;
-    if (p->nyq < min)
-        min = p->nyq;
-    if (p->nyq > max)
-        max = p->nyq;
-    for (int i = 0; i < numbins; i++) {
-        if (p->bin[i].mag < min)
-            min = p->bin[i].mag;
-        if (p->bin[i].mag > max)
-            max = p->bin[i].mag;
+    float min, max;
+    pvMagRange(p, numbins, &min, &max);
+    if (min > max) {
+        // Every magnitude is NaN
+        return;
     }
     p->dc = max - p->dc + min;
     p->nyq = max - p->nyq + min;
@@ -324,6 +366,10 @@ static void PV_MagMirror_Ctor(PV_MagMirror *unit) {
 
 static void PV_MagXFade_next(PV_MagXFade *unit, int inNumSamples) {
     PV_GET_BUF2
+    DenormalScope denormals;
+    if (pvFrameIsSilent(buf1, numbins) && pvFrameIsSilent(buf2, numbins)) {
+        return;
+    }
     float crossfade = IN0(2);
     crossfade = sc_clip(crossfade, 0.f, 1.f);
     SCPolarBuf *p = ToPolarApx(buf1);
@@ -351,6 +397,12 @@ static void PV_MagXFade_Ctor(PV_MagXFade *unit) {
 
 PluginLoad(PV_Jeff) {
     ft = inTable;
+    profileInit(ft, "PV");
+    rtMemInit(ft, "PV");
+    scratchInit(ft);
+    int cpuLevel = cpuDetectLevel();
+    rngFill_select(cpuLevel);
+    pvMagRange_select(cpuLevel);
     DefineSimpleUnit(PV_MagMirror);
     DefineSimpleUnit(PV_MagSqueeze);
     DefineSimpleUnit(PV_MagSqueeze1);
@@ -26,8 +26,8 @@
 // input magnitudes in order to produce a less static frozen spectrum.
 PV_CFreeze : PV_ChainUGen {
     *new {
-        arg buffer, freeze = 0.0, frameMemory = 4;
-        ^this.multiNew('control', buffer, freeze, frameMemory);
+        arg buffer, freeze = 0.0, frameMemory = 4, seed = -1;
+        ^this.multiNew('control', buffer, freeze, frameMemory, seed);
     }
 }
 
@@ -36,8 +36,8 @@ PV_CFreeze : PV_ChainUGen {
 // the trigger is set again.
 PV_BinRandomMask : PV_ChainUGen {
     *new {
-        arg buffer, mask = 0.0, prob = 0.0, expCurve = -1.0, trigger = 0.0;
-        ^this.multiNew('control', buffer, mask, prob, expCurve, trigger);
+        arg buffer, mask = 0.0, prob = 0.0, expCurve = -1.0, trigger = 0.0, seed = -1;
+        ^this.multiNew('control', buffer, mask, prob, expCurve, trigger, seed);
     }
 }
 
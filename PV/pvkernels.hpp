@@ -0,0 +1,163 @@
+/*
+File: pvkernels.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the spectral kernels shared by the PV UGens. The magnitude range scan is
+written by hand for each instruction set level, since compilers do not vectorize float minimum
+and maximum reductions without fast-math. The silence check lets a unit skip its per-bin work
+on frames of digital silence, which are common between notes and would otherwise cost as much as
+any other frame.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "FFT_UGens.h"
+#include "cpudispatch.hpp"
+#include <cmath>
+#include <cstring>
+
+// Folds the magnitudes of bins [start, numbins) into the range. Every version compares in the
+// same way as this loop, so they all agree with it.
+static CPU_KERNEL_INLINE void pvMagRangeScalar(const SCPolar* bins, int start, int numbins, float& min, float& max) {
+    for (int i = start; i < numbins; i++) {
+        float mag = bins[i].mag;
+        min = mag < min ? mag : min;
+        max = mag > max ? mag : max;
+    }
+}
+
+// Folds SIMD lanes of minimums and maximums into the range
+static CPU_KERNEL_INLINE void pvMagRangeLanes(const float* mins, const float* maxes, int numLanes, float& min, float& max) {
+    for (int j = 0; j < numLanes; j++) {
+        min = mins[j] < min ? mins[j] : min;
+        max = maxes[j] > max ? maxes[j] : max;
+    }
+}
+
+// Widens the range in *min and *max to cover the magnitudes of the bins. Each vector version
+// loads bins as interleaved (mag, phase) pairs from two registers and keeps the even lanes.
+static void pvMagRange_baseline(const SCPolar* bins, int numbins, float* min, float* max) {
+    float lo = *min;
+    float hi = *max;
+    int i = 0;
+#if CPU_DISPATCH && defined(__SSE2__)
+    const float* data = &bins[0].mag;
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    for (; i + 4 <= numbins; i += 4) {
+        __m128 mags = _mm_shuffle_ps(_mm_loadu_ps(data + 2 * i), _mm_loadu_ps(data + 2 * i + 4), _MM_SHUFFLE(2, 0, 2, 0));
+        vlo = _mm_min_ps(mags, vlo);
+        vhi = _mm_max_ps(mags, vhi);
+    }
+    float mins[4], maxes[4];
+    _mm_storeu_ps(mins, vlo);
+    _mm_storeu_ps(maxes, vhi);
+    pvMagRangeLanes(mins, maxes, 4, lo, hi);
+#endif
+    pvMagRangeScalar(bins, i, numbins, lo, hi);
+    *min = lo;
+    *max = hi;
+}
+
+#if CPU_DISPATCH
+CPU_TARGET_AVX2 static void pvMagRange_avx2(const SCPolar* bins, int numbins, float* min, float* max) {
+    float lo = *min;
+    float hi = *max;
+    const float* data = &bins[0].mag;
+    __m256 vlo = _mm256_set1_ps(lo);
+    __m256 vhi = _mm256_set1_ps(hi);
+    int i = 0;
+    for (; i + 8 <= numbins; i += 8) {
+        __m256 mags = _mm256_shuffle_ps(_mm256_loadu_ps(data + 2 * i), _mm256_loadu_ps(data + 2 * i + 8), _MM_SHUFFLE(2, 0, 2, 0));
+        vlo = _mm256_min_ps(mags, vlo);
+        vhi = _mm256_max_ps(mags, vhi);
+    }
+    float mins[8], maxes[8];
+    _mm256_storeu_ps(mins, vlo);
+    _mm256_storeu_ps(maxes, vhi);
+    pvMagRangeLanes(mins, maxes, 8, lo, hi);
+    pvMagRangeScalar(bins, i, numbins, lo, hi);
+    *min = lo;
+    *max = hi;
+}
+
+CPU_TARGET_AVX512 static void pvMagRange_avx512(const SCPolar* bins, int numbins, float* min, float* max) {
+    float lo = *min;
+    float hi = *max;
+    const float* data = &bins[0].mag;
+    __m512 vlo = _mm512_set1_ps(lo);
+    __m512 vhi = _mm512_set1_ps(hi);
+    int i = 0;
+    for (; i + 16 <= numbins; i += 16) {
+        __m512 mags = _mm512_shuffle_ps(_mm512_loadu_ps(data + 2 * i), _mm512_loadu_ps(data + 2 * i + 16), _MM_SHUFFLE(2, 0, 2, 0));
+        vlo = _mm512_min_ps(mags, vlo);
+        vhi = _mm512_max_ps(mags, vhi);
+    }
+    float mins[16], maxes[16];
+    _mm512_storeu_ps(mins, vlo);
+    _mm512_storeu_ps(maxes, vhi);
+    pvMagRangeLanes(mins, maxes, 16, lo, hi);
+    pvMagRangeScalar(bins, i, numbins, lo, hi);
+    *min = lo;
+    *max = hi;
+}
+#endif
+
+CPU_DISPATCH_SELECT(pvMagRange, (const SCPolar* bins, int numbins, float* min, float* max))
+
+// Gets the range of the magnitudes of a polar buffer, including DC and Nyquist. NaNs fail every
+// comparison, so they are skipped. If there are only NaNs, min is INFINITY and max is -INFINITY.
+static inline void pvMagRange(const SCPolarBuf* p, int numbins, float* min, float* max) {
+    float lo = INFINITY;
+    float hi = -INFINITY;
+    lo = p->dc < lo ? p->dc : lo;
+    hi = p->dc > hi ? p->dc : hi;
+    lo = p->nyq < lo ? p->nyq : lo;
+    hi = p->nyq > hi ? p->nyq : hi;
+    *min = lo;
+    *max = hi;
+    pvMagRange_impl(p->bin, numbins, min, max);
+}
+
+// Checks whether a frame is silent: every value is zero in a complex buffer, or DC, Nyquist and
+// every magnitude are zero in a polar one. This is an integer OR over the bits, which compilers
+// vectorize, and is much cheaper than converting the frame to polar to find out.
+static inline bool pvFrameIsSilent(const SndBuf* buf, int numbins) {
+    const float* data = buf->data;
+    uint32 bits = 0;
+    if (buf->coord == coord_Polar) {
+        // The phases of silent bins do not matter
+        for (int i = 0; i < numbins + 1; i++) {
+            uint32 value;
+            memcpy(&value, &data[2 * i], sizeof(value));
+            bits |= value;
+        }
+        uint32 nyq;
+        memcpy(&nyq, &data[1], sizeof(nyq));
+        bits |= nyq;
+    } else {
+        for (int i = 0; i < 2 * numbins + 2; i++) {
+            uint32 value;
+            memcpy(&value, &data[i], sizeof(value));
+            bits |= value;
+        }
+    }
+    // Ignore the sign bits, since -0 is silent too
+    return (bits & 0x7FFFFFFFu) == 0;
+}
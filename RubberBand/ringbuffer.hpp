@@ -9,7 +9,10 @@
 //    is available to read. Then you can call readBlock().
 
 #pragma once
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <type_traits>
 
 template <typename T>
 class TestRingBuffer;
@@ -109,4 +112,190 @@ bool RingBuffer<T>::isReadReady() {
 template <typename T>
 size_t RingBuffer<T>::size() {
     return m_size;
-}
\ No newline at end of file
+}
+
+// Workflow for SpscRingBuffer:
+// 1. Make an SpscRingBuffer with the minimum number of frames it must hold and the number of channels.
+//    The capacity is rounded up to a power of two so that indices can be wrapped with a mask.
+//    Each channel has its own planar region of capacity() elements, and all channels share one
+//    pair of read and write indices, so a frame is always written and read on every channel at once.
+// 2. Allocate size() elements separately and provide them with initialize().
+// 3. One thread writes and another reads. Neither side blocks or locks. A transfer that does not fit
+//    is refused whole with RingResult::Overrun or RingResult::Underrun instead of overwriting or
+//    inventing data.
+//    - writeFrames() and readFrames() copy every channel. write() and read() are shorthands for
+//      buffers with a single channel.
+//      Each channel is copied in at most two memcpy segments.
+//    - To work on ring memory in place, call peekWrite() or peekRead() for each channel to get the
+//      spans of up to two contiguous regions, then commitWrite() or commitRead() once for all channels.
+
+enum class RingResult {
+    Ok,
+    Overrun,  // not enough free space for the write
+    Underrun  // not enough unread elements for the read
+};
+
+// Up to two contiguous regions of one channel of a ring buffer, in order. The second region
+// is empty unless the first one reaches the end of the ring memory.
+template <typename T>
+struct RingSpan {
+    T* data[2];
+    size_t length[2];
+    size_t size() const {
+        return length[0] + length[1];
+    }
+};
+
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRingBuffer copies elements with memcpy");
+public:
+    SpscRingBuffer<T>(size_t minCapacity, size_t numChannels = 1);
+    void initialize(T* buffer);
+    size_t size() const;
+    size_t capacity() const;
+    size_t readAvailable() const;
+    size_t writeAvailable() const;
+    RingResult write(const T* samples, size_t length);
+    RingResult read(T* destination, size_t length);
+    RingResult writeFrames(const T* const* samples, size_t length);
+    RingResult readFrames(T* const* destination, size_t length, size_t destinationOffset = 0);
+    RingResult skip(size_t length);
+    RingSpan<T> peekWrite(size_t length, size_t channel = 0);
+    RingSpan<const T> peekRead(size_t length, size_t channel = 0) const;
+    void commitWrite(size_t length);
+    void commitRead(size_t length);
+private:
+    template <typename U>
+    RingSpan<U> span(U* region, size_t index, size_t length) const;
+    T* m_buffer;
+    size_t m_numChannels;
+    size_t m_capacity; // frames per channel, a power of two
+    size_t m_mask;     // m_capacity - 1
+    // The indices count every frame ever written or read, and are only wrapped when used.
+    // Each is stored by one thread only and loaded with acquire by the other.
+    std::atomic<size_t> m_writeIndex;
+    std::atomic<size_t> m_readIndex;
+    template <typename U>
+    friend class TestRingBuffer;
+};
+
+template <typename T>
+SpscRingBuffer<T>::SpscRingBuffer(size_t minCapacity, size_t numChannels)
+    : m_numChannels(numChannels), m_writeIndex(0), m_readIndex(0) {
+    m_buffer = nullptr;
+    m_capacity = 1;
+    while (m_capacity < minCapacity) {
+        m_capacity <<= 1;
+    }
+    m_mask = m_capacity - 1;
+}
+
+template <typename T>
+void SpscRingBuffer<T>::initialize(T* buffer) {
+    m_buffer = buffer;
+}
+
+// Gets the number of elements to allocate for all channels
+template <typename T>
+size_t SpscRingBuffer<T>::size() const {
+    return m_capacity * m_numChannels;
+}
+
+// Gets the number of frames the buffer holds
+template <typename T>
+size_t SpscRingBuffer<T>::capacity() const {
+    return m_capacity;
+}
+
+template <typename T>
+size_t SpscRingBuffer<T>::readAvailable() const {
+    return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t SpscRingBuffer<T>::writeAvailable() const {
+    return m_capacity - (m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_acquire));
+}
+
+template <typename T>
+template <typename U>
+RingSpan<U> SpscRingBuffer<T>::span(U* region, size_t index, size_t length) const {
+    size_t start = index & m_mask;
+    size_t first = length < m_capacity - start ? length : m_capacity - start;
+    return {{region + start, region}, {first, length - first}};
+}
+
+template <typename T>
+RingResult SpscRingBuffer<T>::write(const T* samples, size_t length) {
+    return writeFrames(&samples, length);
+}
+
+template <typename T>
+RingResult SpscRingBuffer<T>::read(T* destination, size_t length) {
+    return readFrames(&destination, length);
+}
+
+template <typename T>
+RingResult SpscRingBuffer<T>::writeFrames(const T* const* samples, size_t length) {
+    if (!m_buffer || length > writeAvailable()) {
+        return RingResult::Overrun;
+    }
+    for (size_t ch = 0; ch < m_numChannels; ch++) {
+        RingSpan<T> region = peekWrite(length, ch);
+        std::memcpy(region.data[0], samples[ch], region.length[0] * sizeof(T));
+        std::memcpy(region.data[1], samples[ch] + region.length[0], region.length[1] * sizeof(T));
+    }
+    commitWrite(length);
+    return RingResult::Ok;
+}
+
+template <typename T>
+RingResult SpscRingBuffer<T>::readFrames(T* const* destination, size_t length, size_t destinationOffset) {
+    if (!m_buffer || length > readAvailable()) {
+        return RingResult::Underrun;
+    }
+    for (size_t ch = 0; ch < m_numChannels; ch++) {
+        RingSpan<const T> region = peekRead(length, ch);
+        T* channel = destination[ch] + destinationOffset;
+        std::memcpy(channel, region.data[0], region.length[0] * sizeof(T));
+        std::memcpy(channel + region.length[0], region.data[1], region.length[1] * sizeof(T));
+    }
+    commitRead(length);
+    return RingResult::Ok;
+}
+
+template <typename T>
+RingResult SpscRingBuffer<T>::skip(size_t length) {
+    if (length > readAvailable()) {
+        return RingResult::Underrun;
+    }
+    commitRead(length);
+    return RingResult::Ok;
+}
+
+// Gets the free space for the next length frames of a channel. The caller must check
+// writeAvailable() first, since the span is not clipped to the free space.
+template <typename T>
+RingSpan<T> SpscRingBuffer<T>::peekWrite(size_t length, size_t channel) {
+    return span(m_buffer + channel * m_capacity, m_writeIndex.load(std::memory_order_relaxed), length);
+}
+
+// Gets the next length unread frames of a channel. The caller must check readAvailable()
+// first, since the span is not clipped to the unread frames.
+template <typename T>
+RingSpan<const T> SpscRingBuffer<T>::peekRead(size_t length, size_t channel) const {
+    return span(static_cast<const T*>(m_buffer + channel * m_capacity), m_readIndex.load(std::memory_order_relaxed), length);
+}
+
+// Publishes length frames written into the spans from peekWrite() on every channel
+template <typename T>
+void SpscRingBuffer<T>::commitWrite(size_t length) {
+    m_writeIndex.store(m_writeIndex.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+// Releases length frames read from the spans from peekRead() on every channel
+template <typename T>
+void SpscRingBuffer<T>::commitRead(size_t length) {
+    m_readIndex.store(m_readIndex.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
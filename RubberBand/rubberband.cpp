@@ -25,51 +25,673 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "SC_InterfaceTable.h"
 #include "FFT_UGens.h"
 #include "SC_Unit.h"
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "rubberband/RubberBandLiveShifter.h"
+#include "rubberband/RubberBandStretcher.h"
 #include "ringbuffer.hpp"
+#include "worker.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#include "rtlog.hpp"
+#include "rtmem.hpp"
 
-InterfaceTable *ft;
+// The number of frames handed to the offline stretcher at a time
+#define RUBBERBANDSTRETCH_CHUNK_SIZE 4096
+
+// Inputs 0 to 3 are the pitch ratio, formant ratio, threaded flag and load budget. The audio channels follow.
+#define RUBBERBANDPS_FIRST_CHANNEL 4
+
+static InterfaceTable *ft;
+
+struct RubberBandPSCmd;
+struct RubberBandPSCore;
 
 struct RubberBandPS : public Unit {
-    RubberBand::RubberBandLiveShifter* m_shifter;
-    RingBuffer<float>* m_sendBuffer;
-    RingBuffer<float>* m_receiveBuffer;
+    RubberBandPSCore* m_core;  // nullptr until the NRT thread has built it
+    RubberBandPSCmd* m_cmd;    // the command building the core, while it is pending
+    float m_pitchRatio;
+    float m_formantRatio;
+    int m_underruns;     // the number of blocks the worker thread did not deliver in time
+    int64 m_debt;        // output samples owed to keep the output aligned after an underrun
+};
+
+// Gets the greatest common divisor of two block sizes
+static size_t blockGcd(size_t a, size_t b) {
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Option sets for the quality tiers, from the best to the cheapest. Every tier uses the same window,
+// so switching tiers does not change the latency.
+static const RubberBand::RubberBandLiveShifter::Options gQualityTiers[] = {
+    RubberBand::RubberBandLiveShifter::OptionFormantPreserved,
+    RubberBand::RubberBandLiveShifter::OptionFormantShifted,
 };
+static const int gNumQualityTiers = sizeof(gQualityTiers) / sizeof(gQualityTiers[0]);
+
+// The shifter with its rings, and optionally the worker thread that runs it. All channels share
+// one shifter, which processes them together. The core allocates everything it owns, so it is
+// created and destroyed on the NRT thread. The audio thread only copies SC blocks into
+// sendBuffer and out of receiveBuffer. The shifter reads and writes the ring memory in place.
+//
+// In adaptive mode the core has one shifter per quality tier, and times each shifter block against
+// the duration of the audio it produces. If the load goes over the budget, the core steps down a
+// tier. If the load stays under half the budget for a second, it steps back up. Only the active
+// tier's shifter runs, so a switch never adds work. The old tier fades out over its last block and
+// the new tier starts from a reset, so the output drops out for the shifter's start delay, but the
+// latency does not change. A shifter that has been switched away from is reset off the audio
+// thread, by the worker or by an asynchronous command, and cannot be switched back to until then.
+struct RubberBandPSCore {
+    std::vector<std::unique_ptr<RubberBand::RubberBandLiveShifter>> shifters;  // one per quality tier
+    int numChannels;
+    size_t blockSize;
+    std::unique_ptr<SpscRingBuffer<float>> sendBuffer;     // collects SC blocks into shifter blocks
+    std::unique_ptr<SpscRingBuffer<float>> receiveBuffer;  // splits shifter blocks into SC blocks
+    std::vector<float> sendMemory;
+    std::vector<float> receiveMemory;
+    std::vector<float> shiftMemory;
+    std::vector<float*> shiftIn;   // a copy of the input block, used only if it wraps around the send buffer
+    std::vector<float*> shiftOut;  // a copy of the output block, used only if it wraps around the receive buffer
+    std::vector<const float*> blockIn;  // the input block of each channel
+    std::vector<float*> blockOut;       // the output block of each channel
+    int latency;                   // total latency in samples
+
+    // Used only in adaptive mode
+    float loadBudget;             // the fraction of real time the shifter may use
+    double blockDuration;         // the duration of one shifter block in seconds
+    double load;                  // smoothed fraction of real time the shifter uses
+    std::atomic<int> activeTier;  // read by the audio thread
+    std::atomic<unsigned> staleTiers;  // one bit for each tier whose shifter needs a reset
+    std::atomic<bool> resetPending;    // set while a reset command is on its way to the NRT thread
+    bool restartLoad;             // set after a switch, so the new tier's first block starts the load afresh
+    int holdBlocks;               // consecutive shifter blocks under half the budget
+    float activePitch;            // the ratios given to the active tier's shifter
+    float activeFormant;
+
+    // Used only with a worker thread
+    bool threaded;
+    std::atomic<float> pitchRatio;    // written by the audio thread
+    std::atomic<float> formantRatio;  // written by the audio thread
+    std::atomic<bool> running;
+    WorkerSemaphore semaphore;
+    std::thread thread;
+    int priorityError;  // nonzero if the system refused the worker's priority
+
+    // A constructor that throws frees whatever it had built, since every member owns its memory
+    RubberBandPSCore(double sampleRate, int numChannels, size_t scBlockSize, bool threaded, float loadBudget,
+        float pitch, float formant, const WorkerPriority& audioPriority)
+        : numChannels(numChannels), loadBudget(loadBudget), load(0.0), activeTier(0), staleTiers(0),
+          resetPending(false), restartLoad(false), holdBlocks(0), activePitch(pitch), activeFormant(formant),
+          threaded(threaded), pitchRatio(pitch), formantRatio(formant), running(true), priorityError(0) {
+        int numTiers = loadBudget > 0.f ? gNumQualityTiers : 1;
+        for (int tier = 0; tier < numTiers; tier++) {
+            RubberBand::RubberBandLiveShifter::Options options = gQualityTiers[tier];
+            if (numChannels > 1) {
+                options |= RubberBand::RubberBandLiveShifter::OptionChannelsTogether;
+            }
+            shifters.emplace_back(new RubberBand::RubberBandLiveShifter(static_cast<size_t>(sampleRate), numChannels, options));
+            applyRatios(*shifters.back());
+        }
+        blockSize = shifters[0]->getBlockSize();
+        blockDuration = blockSize / sampleRate;
+
+        // Without a worker the send buffer holds less than one shifter block plus one SC block, and the
+        // receive buffer less than one shifter block plus the pre-roll. A worker may fall a few blocks behind.
+        size_t capacity = (threaded ? 4 : 1) * (scBlockSize + blockSize);
+        sendBuffer.reset(new SpscRingBuffer<float>(capacity, numChannels));
+        receiveBuffer.reset(new SpscRingBuffer<float>(capacity, numChannels));
+        sendMemory.assign(sendBuffer->size(), 0.f);
+        receiveMemory.assign(receiveBuffer->size(), 0.f);
+        sendBuffer->initialize(sendMemory.data());
+        receiveBuffer->initialize(receiveMemory.data());
+        blockIn.assign(numChannels, nullptr);
+        blockOut.assign(numChannels, nullptr);
+        shiftMemory.assign(2 * numChannels * blockSize, 0.f);
+        for (int ch = 0; ch < numChannels; ch++) {
+            shiftIn.push_back(shiftMemory.data() + ch * blockSize);
+            shiftOut.push_back(shiftMemory.data() + (numChannels + ch) * blockSize);
+        }
+
+        // After n SC blocks the shifter has produced all but (n * scBlockSize) mod blockSize samples of
+        // input, which is at most blockSize - gcd(scBlockSize, blockSize). Starting the receive buffer
+        // with that many zeros means it always holds a full SC block when it is read. A worker gets
+        // one more SC block so that it has a full block period to deliver each block.
+        size_t preRoll = blockSize - blockGcd(scBlockSize, blockSize);
+        if (threaded) {
+            preRoll += scBlockSize;
+        }
+        // Shifter blocks are read from the send buffer at multiples of blockSize. Starting the receive
+        // buffer's indices early by the pre-roll's remainder lines its shifter blocks up the same way.
+        // With a power of two block size, no shifter block then wraps around either ring.
+        size_t alignment = (blockSize - preRoll % blockSize) % blockSize;
+        receiveBuffer->commitWrite(alignment);
+        receiveBuffer->commitRead(alignment);
+        std::vector<float> zeros(preRoll, 0.f);
+        std::vector<const float*> zeroChannels(numChannels, zeros.data());
+        receiveBuffer->writeFrames(zeroChannels.data(), preRoll);
+        latency = static_cast<int>(preRoll + shifters[0]->getStartDelay());
+
+        if (threaded) {
+            thread = std::thread(&RubberBandPSCore::run, this);
+            priorityError = setWorkerThreadPriority(thread, audioPriority);
+        }
+    }
+
+    ~RubberBandPSCore() {
+        if (threaded) {
+            running.store(false, std::memory_order_release);
+            semaphore.post();
+            thread.join();
+        }
+    }
+
+    // Only the active tier's shifter follows the ratios. The others get them when they become active,
+    // so that the thread resetting them never shares a shifter with the thread shifting.
+    void setPitchScale(float pitch) {
+        if (pitch > 0.f) {
+            activePitch = pitch;
+            shifters[activeTier.load(std::memory_order_relaxed)]->setPitchScale(pitch);
+        }
+    }
+
+    void setFormantScale(float formant) {
+        if (formant > 0.f) {
+            activeFormant = formant;
+            shifters[activeTier.load(std::memory_order_relaxed)]->setFormantScale(formant);
+        }
+    }
+
+    void applyRatios(RubberBand::RubberBandLiveShifter& shifter) {
+        if (activePitch > 0.f) {
+            shifter.setPitchScale(activePitch);
+        }
+        if (activeFormant > 0.f) {
+            shifter.setFormantScale(activeFormant);
+        }
+    }
+
+    // Shifts blockIn into blockOut with the active tier
+    void shiftBlock() {
+        int tier = activeTier.load(std::memory_order_relaxed);
+        if (shifters.size() == 1) {
+            shifters[0]->shift(blockIn.data(), blockOut.data());
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        shifters[tier]->shift(blockIn.data(), blockOut.data());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (restartLoad) {
+            load = elapsed.count() / blockDuration;
+            restartLoad = false;
+        } else {
+            load += 0.1 * (elapsed.count() / blockDuration - load);
+        }
+
+        if (load > loadBudget && tier + 1 < static_cast<int>(shifters.size())) {
+            switchTier(tier + 1);
+        } else if (load < 0.5 * loadBudget && tier > 0) {
+            // Step up only after a second of low load, so that a switch does not immediately reverse
+            if (++holdBlocks * blockDuration >= 1.0) {
+                switchTier(tier - 1);
+            }
+        } else {
+            holdBlocks = 0;
+        }
+    }
+
+    // Fades out the current block and hands the next one to a tier, if its shifter has been reset
+    void switchTier(int tier) {
+        if (staleTiers.load(std::memory_order_acquire) & (1u << tier)) {
+            return;
+        }
+        float step = 1.f / blockSize;
+        for (int ch = 0; ch < numChannels; ch++) {
+            float fade = 1.f;
+            for (size_t i = 0; i < blockSize; i++) {
+                fade -= step;
+                blockOut[ch][i] *= fade;
+            }
+        }
+        int previous = activeTier.load(std::memory_order_relaxed);
+        applyRatios(*shifters[tier]);
+        activeTier.store(tier, std::memory_order_relaxed);
+        staleTiers.fetch_or(1u << previous, std::memory_order_relaxed);
+        restartLoad = true;
+        holdBlocks = 0;
+    }
+
+    // Resets the shifters that have been switched away from. This runs on the worker thread, or on
+    // the NRT thread without a worker, and never touches the active shifter.
+    void resetStaleTiers() {
+        unsigned stale = staleTiers.load(std::memory_order_relaxed);
+        for (int tier = 0; tier < static_cast<int>(shifters.size()); tier++) {
+            if (stale & (1u << tier)) {
+                shifters[tier]->reset();
+            }
+        }
+        staleTiers.fetch_and(~stale, std::memory_order_release);
+    }
+
+    // Shifts every complete shifter block that has accumulated in the send buffer. Each block is
+    // shifted straight from the send buffer's memory into the receive buffer's memory, unless it
+    // wraps around the end of either one.
+    void shiftAvailableBlocks() {
+        while (sendBuffer->readAvailable() >= blockSize && receiveBuffer->writeAvailable() >= blockSize) {
+            for (int ch = 0; ch < numChannels; ch++) {
+                RingSpan<const float> in = sendBuffer->peekRead(blockSize, ch);
+                if (in.length[1] == 0) {
+                    blockIn[ch] = in.data[0];
+                } else {
+                    std::copy(in.data[0], in.data[0] + in.length[0], shiftIn[ch]);
+                    std::copy(in.data[1], in.data[1] + in.length[1], shiftIn[ch] + in.length[0]);
+                    blockIn[ch] = shiftIn[ch];
+                }
+                RingSpan<float> out = receiveBuffer->peekWrite(blockSize, ch);
+                blockOut[ch] = out.length[1] == 0 ? out.data[0] : shiftOut[ch];
+            }
+            shiftBlock();
+            for (int ch = 0; ch < numChannels; ch++) {
+                if (blockOut[ch] == shiftOut[ch]) {
+                    RingSpan<float> out = receiveBuffer->peekWrite(blockSize, ch);
+                    std::copy(shiftOut[ch], shiftOut[ch] + out.length[0], out.data[0]);
+                    std::copy(shiftOut[ch] + out.length[0], shiftOut[ch] + blockSize, out.data[1]);
+                }
+            }
+            sendBuffer->commitRead(blockSize);
+            receiveBuffer->commitWrite(blockSize);
+        }
+    }
+
+    // The worker thread
+    void run() {
+        float currentPitch = pitchRatio.load(std::memory_order_relaxed);
+        float currentFormant = formantRatio.load(std::memory_order_relaxed);
+        while (true) {
+            // The audio thread posts once per SC block
+            semaphore.wait();
+            if (!running.load(std::memory_order_acquire)) {
+                break;
+            }
+            float pitch = pitchRatio.load(std::memory_order_relaxed);
+            float formant = formantRatio.load(std::memory_order_relaxed);
+            if (pitch != currentPitch) {
+                setPitchScale(pitch);
+                currentPitch = pitch;
+            }
+            if (formant != currentFormant) {
+                setFormantScale(formant);
+                currentFormant = formant;
+            }
+            shiftAvailableBlocks();
+            if (staleTiers.load(std::memory_order_relaxed) != 0) {
+                resetStaleTiers();
+            }
+        }
+    }
+};
+
+// Carries a core between the RT and NRT threads
+struct RubberBandPSCmd {
+    RubberBandPS* unit;  // the unit waiting for the core, or nullptr if there is none
+    RubberBandPSCore* core;
+    bool threaded;
+    float loadBudget;
+    int numChannels;
+    double sampleRate;
+    size_t scBlockSize;
+    float pitchRatio;
+    float formantRatio;
+    WorkerPriority audioPriority;  // the scheduling of the audio thread that started the unit
+};
+
+// Set once the failure to raise a worker's priority has been reported, so it is only printed once
+static std::atomic<bool> gPriorityErrorReported(false);
+
+// Stage 2 (NRT thread): construct the core
+static bool RubberBandPS_createCore(World *world, void *cmdData) {
+    RubberBandPSCmd *cmd = (RubberBandPSCmd*)cmdData;
+    // If the shifter or the worker cannot be created, the unit never gets a core and stays silent
+    try {
+        cmd->core = new RubberBandPSCore(cmd->sampleRate, cmd->numChannels, cmd->scBlockSize, cmd->threaded,
+            cmd->loadBudget, cmd->pitchRatio, cmd->formantRatio, cmd->audioPriority);
+    } catch (const std::exception& e) {
+        Print("RubberBandPS: could not create the shifter (%s); the unit will output silence\n", e.what());
+        cmd->core = nullptr;
+        return true;
+    } catch (...) {
+        Print("RubberBandPS: could not create the shifter; the unit will output silence\n");
+        cmd->core = nullptr;
+        return true;
+    }
+    if (cmd->core->priorityError != 0 && !gPriorityErrorReported.exchange(true)) {
+        Print("RubberBandPS: could not give the worker thread real-time priority (error %d); "
+            "threaded voices may underrun\n", cmd->core->priorityError);
+    }
+    return true;
+}
+
+// Stage 3 (RT thread): hand the core to the unit, unless the unit has been freed meanwhile
+static bool RubberBandPS_handOver(World *world, void *cmdData) {
+    RubberBandPSCmd *cmd = (RubberBandPSCmd*)cmdData;
+    if (cmd->unit) {
+        cmd->unit->m_cmd = nullptr;
+        cmd->unit->m_core = cmd->core;
+        cmd->core = nullptr;
+    }
+    return true;
+}
+
+// Stage 2 or 4 (NRT thread): destroy a core that no unit owns
+static bool RubberBandPS_destroyCore(World *world, void *cmdData) {
+    RubberBandPSCmd *cmd = (RubberBandPSCmd*)cmdData;
+    delete cmd->core;
+    cmd->core = nullptr;
+    return true;
+}
+
+// Stage 2 (NRT thread): reset the shifters of the tiers that have been switched away from
+static bool RubberBandPS_resetTiers(World *world, void *cmdData) {
+    RubberBandPSCmd *cmd = (RubberBandPSCmd*)cmdData;
+    cmd->core->resetStaleTiers();
+    cmd->core->resetPending.store(false, std::memory_order_release);
+    return true;
+}
+
+// Cleanup (RT thread)
+static void RubberBandPS_freeCmd(World *world, void *cmdData) {
+    rtMemFree(world, cmdData);
+}
+
+// Outputs silence until the core arrives from the NRT thread
+static void RubberBandPS_clear(RubberBandPS *unit, int inNumSamples) {
+    for (uint32 ch = 0; ch < unit->mNumOutputs; ch++) {
+        Fill(inNumSamples, OUT(ch), 0.f);
+    }
+}
 
 static void RubberBandPS_next(RubberBandPS *unit, int inNumSamples) {
-    
+    RubberBandPSCore *core = unit->m_core;
+    if (!core) {
+        RubberBandPS_clear(unit, inNumSamples);
+        return;
+    }
+    int numChannels = core->numChannels;
+    float pitchRatio = IN0(0);
+    float formantRatio = IN0(1);
+
+    // The ratios must stay positive
+    if (pitchRatio != unit->m_pitchRatio && pitchRatio > 0.f) {
+        core->setPitchScale(pitchRatio);
+        unit->m_pitchRatio = pitchRatio;
+    }
+    if (formantRatio != unit->m_formantRatio && formantRatio > 0.f) {
+        core->setFormantScale(formantRatio);
+        unit->m_formantRatio = formantRatio;
+    }
+
+    core->sendBuffer->writeFrames(unit->mInBuf + RUBBERBANDPS_FIRST_CHANNEL, inNumSamples);
+    core->shiftAvailableBlocks();
+
+    // Reset the shifter of a tier that has just been switched away from on the NRT thread. The
+    // command is queued ahead of any that destroys the core, so the core outlives it.
+    if (core->staleTiers.load(std::memory_order_relaxed) != 0 && !core->resetPending.load(std::memory_order_acquire)) {
+        RubberBandPSCmd *cmd = (RubberBandPSCmd*)rtMemAlloc(unit, "RubberBandPS", sizeof(RubberBandPSCmd));
+        if (cmd) {
+            cmd->unit = nullptr;
+            cmd->core = core;
+            core->resetPending.store(true, std::memory_order_relaxed);
+            DoAsynchronousCommand(unit->mWorld, nullptr, "", cmd, RubberBandPS_resetTiers, nullptr, nullptr,
+                RubberBandPS_freeCmd, 0, nullptr);
+        }
+    }
+
+    // The pre-roll guarantees a full SC block here
+    if (core->receiveBuffer->readFrames(unit->mOutBuf, inNumSamples) != RingResult::Ok) {
+        for (int ch = 0; ch < numChannels; ch++) {
+            Fill(inNumSamples, OUT(ch), 0.f);
+        }
+    }
+    Fill(inNumSamples, OUT(numChannels), static_cast<float>(core->latency));
+    Fill(inNumSamples, OUT(numChannels + 1), 0.f);
+    Fill(inNumSamples, OUT(numChannels + 2), static_cast<float>(core->activeTier.load(std::memory_order_relaxed)));
+}
+
+// Calc function for shifting on a worker thread. This only copies audio into and out of the core's rings.
+static void RubberBandPS_next_worker(RubberBandPS *unit, int inNumSamples) {
+    RubberBandPSCore *core = unit->m_core;
+    if (!core) {
+        RubberBandPS_clear(unit, inNumSamples);
+        return;
+    }
+    int numChannels = core->numChannels;
+    core->pitchRatio.store(IN0(0), std::memory_order_relaxed);
+    core->formantRatio.store(IN0(1), std::memory_order_relaxed);
+
+    // If the worker has stalled long enough to fill its input rings, this block is dropped
+    // and the output owes a block of silence in its place.
+    int64 debt = unit->m_debt;
+    if (core->sendBuffer->writeFrames(unit->mInBuf + RUBBERBANDPS_FIRST_CHANNEL, inNumSamples) != RingResult::Ok) {
+        debt -= inNumSamples;
+        unit->m_underruns++;
+    }
+    core->semaphore.post();
+
+    // Keep the output aligned with the input after an underrun. A positive debt is late output
+    // to discard, and a negative debt is dropped input to replace with silence.
+    if (debt > 0) {
+        int64 numSkipped = sc_min(debt, static_cast<int64>(core->receiveBuffer->readAvailable()));
+        core->receiveBuffer->skip(numSkipped);
+        debt -= numSkipped;
+    }
+    int numSilent = 0;
+    if (debt < 0) {
+        numSilent = static_cast<int>(sc_min(-debt, static_cast<int64>(inNumSamples)));
+        for (int ch = 0; ch < numChannels; ch++) {
+            Fill(numSilent, OUT(ch), 0.f);
+        }
+        debt += numSilent;
+    }
+    int numRead = inNumSamples - numSilent;
+    if (numRead > 0 && core->receiveBuffer->readFrames(unit->mOutBuf, numRead, numSilent) != RingResult::Ok) {
+        // The worker fell behind. Output silence and discard its output for this block once it arrives.
+        for (int ch = 0; ch < numChannels; ch++) {
+            Fill(numRead, OUT(ch) + numSilent, 0.f);
+        }
+        debt += numRead;
+        unit->m_underruns++;
+    }
+    unit->m_debt = debt;
+
+    Fill(inNumSamples, OUT(numChannels), static_cast<float>(core->latency));
+    Fill(inNumSamples, OUT(numChannels + 1), static_cast<float>(unit->m_underruns));
+    Fill(inNumSamples, OUT(numChannels + 2), static_cast<float>(core->activeTier.load(std::memory_order_relaxed)));
 }
 
 static void RubberBandPS_Ctor(RubberBandPS *unit) {
-    float pitchRatio = IN0(1);
-    float formantRatio = IN0(2);
-    // 0x01000000  // formant preserving
-    // 0x00000000  // no formant preservation
-    unit->m_shifter = (RubberBand::RubberBandLiveShifter*)RTAlloc(unit->mWorld, sizeof(RubberBand::RubberBandLiveShifter));
-    new (unit->m_shifter) RubberBand::RubberBandLiveShifter(SAMPLERATE, 1, 0x01000000);
-    unit->m_sendBuffer = (RingBuffer<float>*)RTAlloc(unit->mWorld, sizeof(RingBuffer<float>));
-    new (unit->m_sendBuffer) RingBuffer<float>(BUFLENGTH, unit->m_shifter->getBlockSize(), 5);
-    unit->m_receiveBuffer = (RingBuffer<float>*)RTAlloc(unit->mWorld, sizeof(RingBuffer<float>));
-    new (unit->m_sendBuffer) RingBuffer<float>(unit->m_shifter->getBlockSize(), BUFLENGTH, 5);
-    SETCALC(RubberBandPS_next);
-    unit->m_shifter->setPitchScale(pitchRatio);
-    std::cout << "RubberBand info:" << std::endl;
-    std::cout << "Pitch Scale: " << unit->m_shifter->getPitchScale() << std::endl;
-    std::cout << "Formant Scale: " << unit->m_shifter->getFormantScale() << std::endl;
-    std::cout << "Start Delay: " << unit->m_shifter->getStartDelay() << std::endl;
-    std::cout << "Channels: " << unit->m_shifter->getChannelCount() << std::endl;
-    std::cout << "Block Size: " << unit->m_shifter->getBlockSize() << std::endl;
+    unit->m_core = nullptr;
+    unit->m_cmd = nullptr;
+    unit->m_pitchRatio = IN0(0);
+    unit->m_formantRatio = IN0(1);
+    unit->m_underruns = 0;
+    unit->m_debt = 0;
+    int numChannels = static_cast<int>(unit->mNumInputs) - RUBBERBANDPS_FIRST_CHANNEL;
+    bool threaded = IN0(2) > 0.f;
+    if (threaded) {
+        SETCALC(RubberBandPS_next_worker);
+    } else {
+        SETCALC(RubberBandPS_next);
+    }
+    RubberBandPS_clear(unit, 1);
+    if (numChannels < 1 || static_cast<int>(unit->mNumOutputs) != numChannels + 3) {
+        rtLog(unit, "RubberBandPS", "expected one output per input channel, plus latency, underruns and quality tier");
+        SETCALC(*ClearUnitOutputs);
+        return;
+    }
+
+    // Build the core on the NRT thread
+    RubberBandPSCmd *cmd = (RubberBandPSCmd*)rtMemAlloc(unit, "RubberBandPS", sizeof(RubberBandPSCmd));
+    if (!cmd) {
+        SETCALC(*ClearUnitOutputs);
+        return;
+    }
+    cmd->unit = unit;
+    cmd->core = nullptr;
+    cmd->threaded = threaded;
+    cmd->loadBudget = IN0(3);
+    cmd->numChannels = numChannels;
+    cmd->sampleRate = SAMPLERATE;
+    cmd->scBlockSize = BUFLENGTH;
+    cmd->pitchRatio = unit->m_pitchRatio;
+    cmd->formantRatio = unit->m_formantRatio;
+    cmd->audioPriority = currentThreadPriority();
+    unit->m_cmd = cmd;
+    DoAsynchronousCommand(unit->mWorld, nullptr, "", cmd, RubberBandPS_createCore, RubberBandPS_handOver,
+        RubberBandPS_destroyCore, RubberBandPS_freeCmd, 0, nullptr);
 }
 
 static void RubberBandPS_Dtor(RubberBandPS *unit) {
-    RTFree(unit->mWorld, unit->m_shifter);
-    RTFree(unit->mWorld, unit->m_sendBuffer);
-    RTFree(unit->mWorld, unit->m_receiveBuffer);
+    if (unit->m_cmd) {
+        // The core is still being built. The command destroys it once it is done.
+        unit->m_cmd->unit = nullptr;
+    }
+    if (unit->m_core) {
+        // Destroy the core, and stop its worker, on the NRT thread
+        RubberBandPSCmd *cmd = (RubberBandPSCmd*)rtMemAlloc(unit, "RubberBandPS", sizeof(RubberBandPSCmd));
+        if (cmd) {
+            cmd->unit = nullptr;
+            cmd->core = unit->m_core;
+            DoAsynchronousCommand(unit->mWorld, nullptr, "", cmd, RubberBandPS_destroyCore, nullptr,
+                nullptr, RubberBandPS_freeCmd, 0, nullptr);
+        } else {
+            rtLog(unit, "RubberBandPS", "leaking a shifter, since its destruction could not be scheduled");
+        }
+    }
+}
+
+// Buffer fill command that time-stretches and pitch-shifts a source buffer into the destination buffer
+// with RubberBandStretcher in offline mode:
+//   /b_gen destBuf "rubberBandStretch" srcBuf timeRatio pitchScale formantPreserved formantScale
+// Buffer fill commands run on the NRT thread, so even a long buffer never blocks the audio thread,
+// but it does hold up other asynchronous commands until it finishes. The destination buffer is
+// reallocated to the stretched length, and the server frees its old memory. The source buffer may
+// be the destination buffer.
+static void RubberBandStretch_gen(World *world, SndBuf *buf, sc_msg_iter *msg) {
+    int srcBufNum = msg->geti(-1);
+    double timeRatio = msg->getf(1.f);
+    double pitchScale = msg->getf(1.f);
+    bool formantPreserved = msg->geti(0) > 0;
+    double formantScale = msg->getf(0.f);
+    if (srcBufNum < 0 || static_cast<uint32>(srcBufNum) >= world->mNumSndBufs) {
+        Print("rubberBandStretch: invalid source buffer %d\n", srcBufNum);
+        return;
+    }
+    if (timeRatio <= 0.0 || pitchScale <= 0.0) {
+        Print("rubberBandStretch: the time ratio and pitch scale must be positive\n");
+        return;
+    }
+    SndBuf *src = World_GetNRTBuf(world, srcBufNum);
+    int numChannels = src->channels;
+    size_t numFrames = src->frames;
+    double sampleRate = src->samplerate;
+    const float *srcData = src->data;
+    if (!srcData || numFrames == 0) {
+        Print("rubberBandStretch: source buffer %d is empty\n", srcBufNum);
+        return;
+    }
+
+    // The NRT thread already keeps this off the audio thread, so the stretcher does not need threads of its own
+    RubberBand::RubberBandStretcher::Options options = RubberBand::RubberBandStretcher::OptionProcessOffline
+        | RubberBand::RubberBandStretcher::OptionThreadingNever
+        | RubberBand::RubberBandStretcher::OptionEngineFiner;
+    if (formantPreserved) {
+        options |= RubberBand::RubberBandStretcher::OptionFormantPreserved;
+    }
+    if (numChannels > 1) {
+        options |= RubberBand::RubberBandStretcher::OptionChannelsTogether;
+    }
+    RubberBand::RubberBandStretcher stretcher(static_cast<size_t>(sampleRate), numChannels, options, timeRatio, pitchScale);
+    if (formantScale > 0.0) {
+        stretcher.setFormantScale(formantScale);
+    }
+    stretcher.setExpectedInputDuration(numFrames);
+    stretcher.setMaxProcessSize(RUBBERBANDSTRETCH_CHUNK_SIZE);
+
+    std::vector<float> chunkMemory(numChannels * RUBBERBANDSTRETCH_CHUNK_SIZE);
+    std::vector<float*> chunk(numChannels);
+    for (int ch = 0; ch < numChannels; ch++) {
+        chunk[ch] = chunkMemory.data() + ch * RUBBERBANDSTRETCH_CHUNK_SIZE;
+    }
+
+    // Deinterleaves numChunkFrames frames of the source, starting at frame start, into chunk
+    auto readChunk = [&](size_t start, size_t numChunkFrames) {
+        const float *frame = srcData + start * numChannels;
+        for (size_t i = 0; i < numChunkFrames; i++) {
+            for (int ch = 0; ch < numChannels; ch++) {
+                chunk[ch][i] = frame[ch];
+            }
+            frame += numChannels;
+        }
+    };
+
+    // Offline mode reads the whole input once to plan the stretch, then again to process it
+    for (size_t start = 0; start < numFrames; start += RUBBERBANDSTRETCH_CHUNK_SIZE) {
+        size_t numChunkFrames = sc_min(numFrames - start, static_cast<size_t>(RUBBERBANDSTRETCH_CHUNK_SIZE));
+        readChunk(start, numChunkFrames);
+        stretcher.study(chunk.data(), numChunkFrames, start + numChunkFrames >= numFrames);
+    }
+    std::vector<std::vector<float>> output(numChannels);
+    for (int ch = 0; ch < numChannels; ch++) {
+        output[ch].reserve(static_cast<size_t>(numFrames * timeRatio) + RUBBERBANDSTRETCH_CHUNK_SIZE);
+    }
+    for (size_t start = 0; start < numFrames; start += RUBBERBANDSTRETCH_CHUNK_SIZE) {
+        size_t numChunkFrames = sc_min(numFrames - start, static_cast<size_t>(RUBBERBANDSTRETCH_CHUNK_SIZE));
+        readChunk(start, numChunkFrames);
+        stretcher.process(chunk.data(), numChunkFrames, start + numChunkFrames >= numFrames);
+
+        // Without threads the stretcher has produced everything it can by the time process() returns
+        int numAvailable;
+        while ((numAvailable = stretcher.available()) > 0) {
+            size_t numRetrieved = stretcher.retrieve(chunk.data(),
+                sc_min(static_cast<size_t>(numAvailable), static_cast<size_t>(RUBBERBANDSTRETCH_CHUNK_SIZE)));
+            for (int ch = 0; ch < numChannels; ch++) {
+                output[ch].insert(output[ch].end(), chunk[ch], chunk[ch] + numRetrieved);
+            }
+        }
+    }
+
+    // The source has been read completely, so it is safe to reallocate it if it is also the destination
+    int numOutputFrames = static_cast<int>(output[0].size());
+    if (numOutputFrames == 0) {
+        Print("rubberBandStretch: the stretcher produced no output\n");
+        return;
+    }
+    if (ft->fBufAlloc(buf, numChannels, numOutputFrames, sampleRate) != 0) {
+        Print("rubberBandStretch: failed to allocate %d frames\n", numOutputFrames);
+        return;
+    }
+    float *frame = buf->data;
+    for (int i = 0; i < numOutputFrames; i++) {
+        for (int ch = 0; ch < numChannels; ch++) {
+            frame[ch] = output[ch][i];
+        }
+        frame += numChannels;
+    }
 }
 
-PluginLoad(PV_Jeff) {
+PluginLoad(RubberBandPS) {
     ft = inTable;
-    // DefineSimpleUnit(PV_MagMirror);
+    profileInit(ft, "RubberBand");
+    rtMemInit(ft, "RubberBand");
     DefineDtorUnit(RubberBandPS);
+    DefineBufGen("rubberBandStretch", RubberBandStretch_gen);
 }
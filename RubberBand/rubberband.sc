@@ -23,9 +23,50 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 // RubberBandPS is a phase vocoder based pitch shifter using the Rubber Band library.
-RubberBandPS : UGen {
+// in may be an array of channels, which are shifted together by one shifter. The channels
+// come last in the input list so that any number of them can follow the control inputs.
+// threaded and loadBudget come after mul and add so that older positional calls keep their meaning.
+// ar returns the shifted signal (an array if in is an array). arWithInfo also returns the
+// diagnostic outputs: the latency in samples, the number of underruns of the worker thread, and
+// the active quality tier. mul and add only apply to the shifted signal.
+RubberBandPS : MultiOutUGen {
     *ar {
-        arg in, pitchRatio=1.0, formantRatio=1.0, mul=1.0, add=0.0;
-        ^this.multiNew('audio', in, pitchRatio, formantRatio).madd(mul, add);
+        arg in, pitchRatio=1.0, formantRatio=1.0, mul=1.0, add=0.0, threaded=0, loadBudget=0;
+        ^this.prMake(in, pitchRatio, formantRatio, mul, add, threaded, loadBudget, false);
+    }
+    *arWithInfo {
+        arg in, pitchRatio=1.0, formantRatio=1.0, mul=1.0, add=0.0, threaded=0, loadBudget=0;
+        ^this.prMake(in, pitchRatio, formantRatio, mul, add, threaded, loadBudget, true);
+    }
+    *prMake {
+        arg in, pitchRatio, formantRatio, mul, add, threaded, loadBudget, withInfo;
+        var numChannels = in.asArray.size;
+        var outs = this.multiNewList(['audio', pitchRatio, formantRatio, threaded, loadBudget] ++ in.asArray);
+        var split = { |o|
+            var sig = o.keep(numChannels).madd(mul, add);
+            sig = if(in.isArray) { sig } { sig[0] };
+            if(withInfo) { [sig] ++ o.copyRange(numChannels, numChannels + 2) } { sig }
+        };
+        if(outs[0].isArray) {
+            ^outs.collect(split);
+        };
+        ^split.(outs);
+    }
+    init {
+        arg ... theInputs;
+        inputs = theInputs;
+        // One output per channel, plus the latency, underruns and quality tier
+        ^this.initOutputs(inputs.size - 1, rate);
+    }
+}
+
++ Buffer {
+    // Fills this buffer with srcBuffer time-stretched by timeRatio and pitch-shifted by pitchScale.
+    // The server does the work on its NRT thread and resizes this buffer to fit, so call
+    // updateInfo after syncing to see the new number of frames.
+    rubberBandStretch {
+        arg srcBuffer, timeRatio=1.0, pitchScale=1.0, formantPreserved=false, formantScale=0.0;
+        server.sendMsg("/b_gen", bufnum, "rubberBandStretch", srcBuffer.bufnum, timeRatio, pitchScale,
+            formantPreserved.asBoolean.binaryValue, formantScale);
     }
 }
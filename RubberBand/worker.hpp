@@ -0,0 +1,139 @@
+/*
+File: worker.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the platform pieces for running DSP on a worker thread: a counting semaphore
+that the audio thread can post without blocking, and helpers that give a thread a real-time
+priority just below the audio thread's where the system allows it.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <thread>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <pthread.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+// A counting semaphore. post() never blocks, so it is safe to call from the audio thread.
+class WorkerSemaphore {
+public:
+    WorkerSemaphore() {
+#if defined(_WIN32)
+        m_sem = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr);
+#elif defined(__APPLE__)
+        m_sem = dispatch_semaphore_create(0);
+#else
+        sem_init(&m_sem, 0, 0);
+#endif
+    }
+
+    ~WorkerSemaphore() {
+#if defined(_WIN32)
+        CloseHandle(m_sem);
+#elif defined(__APPLE__)
+        dispatch_release(m_sem);
+#else
+        sem_destroy(&m_sem);
+#endif
+    }
+
+    WorkerSemaphore(const WorkerSemaphore&) = delete;
+    WorkerSemaphore& operator=(const WorkerSemaphore&) = delete;
+
+    void post() {
+#if defined(_WIN32)
+        ReleaseSemaphore(m_sem, 1, nullptr);
+#elif defined(__APPLE__)
+        dispatch_semaphore_signal(m_sem);
+#else
+        sem_post(&m_sem);
+#endif
+    }
+
+    void wait() {
+#if defined(_WIN32)
+        WaitForSingleObject(m_sem, INFINITE);
+#elif defined(__APPLE__)
+        dispatch_semaphore_wait(m_sem, DISPATCH_TIME_FOREVER);
+#else
+        while (sem_wait(&m_sem) != 0) {
+            // retry if interrupted by a signal
+        }
+#endif
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE m_sem;
+#elif defined(__APPLE__)
+    dispatch_semaphore_t m_sem;
+#else
+    sem_t m_sem;
+#endif
+};
+
+// The scheduling of a thread, as read from the audio thread before a worker starts
+struct WorkerPriority {
+    int policy;
+    int priority;
+};
+
+// Reads the scheduling of the calling thread
+inline WorkerPriority currentThreadPriority() {
+    WorkerPriority current;
+#if defined(_WIN32)
+    current.policy = 0;
+    current.priority = GetThreadPriority(GetCurrentThread());
+#else
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &current.policy, &param) != 0) {
+        current.policy = SCHED_OTHER;
+        param.sched_priority = 0;
+    }
+    current.priority = param.sched_priority;
+#endif
+    return current;
+}
+
+// Gives a worker thread a priority one step below the audio thread's, so that the worker never
+// preempts the thread that waits for it. If the audio thread is not real-time, the worker keeps
+// its normal priority. Returns 0, or the error if the system refused the priority.
+inline int setWorkerThreadPriority(std::thread& thread, const WorkerPriority& audio) {
+#if defined(_WIN32)
+    int priority = audio.priority == THREAD_PRIORITY_TIME_CRITICAL ? THREAD_PRIORITY_HIGHEST : audio.priority - 1;
+    if (priority <= THREAD_PRIORITY_NORMAL) {
+        return 0;
+    }
+    return SetThreadPriority(thread.native_handle(), priority) ? 0 : static_cast<int>(GetLastError());
+#else
+    if (audio.policy != SCHED_FIFO && audio.policy != SCHED_RR) {
+        return 0;
+    }
+    sched_param param;
+    int lowest = sched_get_priority_min(audio.policy);
+    param.sched_priority = audio.priority - 1 > lowest ? audio.priority - 1 : lowest;
+    return pthread_setschedparam(thread.native_handle(), audio.policy, &param);
+#endif
+}
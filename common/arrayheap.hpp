@@ -1,3 +1,6 @@
+#pragma once
+#include <cstddef>
+
 // A min heap for ints.
 typedef struct {
     int* heap;
@@ -6,7 +9,7 @@ typedef struct {
 } IntMinHeap;
 
 // Inserts into the heap
-int heapInsert(IntMinHeap* heap, int data) {
+inline int heapInsert(IntMinHeap* heap, int data) {
     if (heap->size == heap->maxSize) {
         return 0;
     } else {
@@ -35,7 +38,7 @@ int heapInsert(IntMinHeap* heap, int data) {
 }
 
 // Removes from the heap and returns the value popped. Returns 0 if the heap is empty.
-int heapPop(IntMinHeap* heap) {
+inline int heapPop(IntMinHeap* heap) {
     if (heap->size > 1) {
         int val = heap->heap[1];
         heap->heap[1] = heap->heap[heap->size-1];
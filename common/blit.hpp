@@ -0,0 +1,132 @@
+/*
+File: blit.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the band-limited impulse table shared by the impulse UGens.
+The table holds a minimum-phase band-limited impulse, oversampled so that an impulse can be
+placed at any sub-sample position. Minimum phase keeps the kernel causal, so an impulse can be
+written as soon as the phasor wraps, without any lookahead.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#define BLIT_LENGTH 16                                        // kernel length in samples
+#define BLIT_OVERSAMPLE_BITS 6
+#define BLIT_OVERSAMPLE (1 << BLIT_OVERSAMPLE_BITS)           // table points per sample
+#define BLIT_TABLE_SIZE (BLIT_LENGTH * BLIT_OVERSAMPLE + 1)
+#define BLIT_CUTOFF 0.45                                      // cutoff as a fraction of the sample rate
+#define BLIT_FRAC_BITS 12                                     // fixed-point resolution of sub-sample positions
+#define BLIT_FRAC_ONE (1 << BLIT_FRAC_BITS)
+
+// The table is filled once by blitTableInit() at PluginLoad and is only read afterwards.
+// The last point is 0 so that interpolation never reads past the end.
+static float gBlitTable[BLIT_TABLE_SIZE];
+
+// In-place radix-2 FFT. The size must be a power of two. inverse selects the unscaled inverse transform.
+static inline void blitFFT(std::vector<std::complex<double>>& x, bool inverse) {
+    size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double angle = 2.0 * M_PI / len * (inverse ? 1.0 : -1.0);
+        std::complex<double> wlen(cos(angle), sin(angle));
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> w(1.0);
+            for (size_t k = 0; k < len / 2; k++) {
+                std::complex<double> u = x[i + k];
+                std::complex<double> v = x[i + k + len / 2] * w;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+}
+
+// Computes the band-limited impulse table. This allocates, so it must only be called from PluginLoad.
+// A Blackman-windowed sinc is converted to minimum phase with the real cepstrum, then scaled so that
+// the samples of an impulse sum to 1 wherever it falls between samples.
+static inline void blitTableInit() {
+    const int kernelSize = BLIT_LENGTH * BLIT_OVERSAMPLE;
+    const size_t fftSize = 8 * kernelSize;  // padding keeps cepstral aliasing small
+    std::vector<std::complex<double>> x(fftSize, 0.0);
+
+    // Linear-phase windowed sinc at the oversampled rate
+    double center = 0.5 * (kernelSize - 1);
+    for (int i = 0; i < kernelSize; i++) {
+        double t = (i - center) / BLIT_OVERSAMPLE;
+        double arg = 2.0 * M_PI * BLIT_CUTOFF * t;
+        double sinc = t == 0.0 ? 1.0 : sin(arg) / arg;
+        double w = 2.0 * M_PI * i / (kernelSize - 1);
+        double window = 0.42 - 0.5 * cos(w) + 0.08 * cos(2.0 * w);
+        x[i] = sinc * window;
+    }
+
+    // Real cepstrum of the kernel
+    blitFFT(x, false);
+    for (size_t i = 0; i < fftSize; i++) {
+        x[i] = log(std::max(std::abs(x[i]), 1e-12));
+    }
+    blitFFT(x, true);
+
+    // Fold the cepstrum onto positive quefrencies, which yields the minimum-phase spectrum
+    for (size_t i = 1; i < fftSize / 2; i++) {
+        x[i] = 2.0 * x[i].real() / static_cast<double>(fftSize);
+    }
+    x[0] = x[0].real() / static_cast<double>(fftSize);
+    x[fftSize / 2] = x[fftSize / 2].real() / static_cast<double>(fftSize);
+    for (size_t i = fftSize / 2 + 1; i < fftSize; i++) {
+        x[i] = 0.0;
+    }
+    blitFFT(x, false);
+    for (size_t i = 0; i < fftSize; i++) {
+        x[i] = std::exp(x[i]);
+    }
+    blitFFT(x, true);
+
+    double sum = 0.0;
+    for (int i = 0; i < kernelSize; i++) {
+        sum += x[i].real();
+    }
+    double scale = BLIT_OVERSAMPLE / sum;
+    for (int i = 0; i < kernelSize; i++) {
+        gBlitTable[i] = static_cast<float>(x[i].real() * scale);
+    }
+    gBlitTable[kernelSize] = 0.f;
+}
+
+// Gets the value of the kernel at pos, a sample offset in BLIT_FRAC_BITS fixed point
+static inline float blitLookup(int pos) {
+    const int shift = BLIT_FRAC_BITS - BLIT_OVERSAMPLE_BITS;
+    int idx = pos >> shift;
+    float frac = static_cast<float>(pos & ((1 << shift) - 1)) * (1.f / (1 << shift));
+    return gBlitTable[idx] + frac * (gBlitTable[idx + 1] - gBlitTable[idx]);
+}
@@ -0,0 +1,74 @@
+/*
+File: calcwrap.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the machinery that the instrumented builds (profile.hpp and rtcheck.hpp) use to
+run code around every calc function. Calc functions are plain function pointers chosen at runtime,
+so each one a unit type installs gets a slot, and a wrapper generated for that slot calls the
+hook with the original function.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+// The number of different calc functions one unit type can install
+#define CALC_WRAP_MAX_FUNCS 16
+
+// Wraps the calc functions of a unit type. Hook::call<UnitType>(func, unit, inNumSamples) runs each block.
+template <typename UnitType, typename Hook>
+struct CalcWrap {
+    static std::atomic<UnitCalcFunc> sFuncs[CALC_WRAP_MAX_FUNCS];  // the calc functions being wrapped
+
+    template <int Index>
+    static void calc(Unit* unit, int inNumSamples) {
+        Hook::template call<UnitType>(sFuncs[Index].load(std::memory_order_relaxed), unit, inNumSamples);
+    }
+
+    template <int... Index>
+    static UnitCalcFunc wrapper(int index, std::integer_sequence<int, Index...>) {
+        static const UnitCalcFunc wrappers[] = {&calc<Index>...};
+        return wrappers[index];
+    }
+
+    // Gets the wrapper for a calc function, giving the function a slot the first time it is installed.
+    // Ctors on different DSP threads may race for a slot, so slots are claimed with compare-exchange.
+    // If every slot is taken, the function runs unwrapped.
+    static UnitCalcFunc wrap(UnitCalcFunc func) {
+        for (int i = 0; i < CALC_WRAP_MAX_FUNCS; i++) {
+            UnitCalcFunc current = sFuncs[i].load(std::memory_order_acquire);
+            if (!current && sFuncs[i].compare_exchange_strong(current, func, std::memory_order_acq_rel)) {
+                current = func;
+            }
+            if (current == func) {
+                return wrapper(i, std::make_integer_sequence<int, CALC_WRAP_MAX_FUNCS>());
+            }
+        }
+        return func;
+    }
+};
+
+template <typename UnitType, typename Hook>
+std::atomic<UnitCalcFunc> CalcWrap<UnitType, Hook>::sFuncs[CALC_WRAP_MAX_FUNCS];
+
+// The type of the unit in a Ctor, for SETCALC
+#define CALC_WRAP_UNIT_TYPE typename std::remove_pointer<decltype(unit)>::type
@@ -0,0 +1,130 @@
+/*
+File: counterrng.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the seedable random number generator shared by the random UGens.
+It is a Philox4x32-10 counter-based generator: each output is a pure function of a key and
+a counter, so a given seed always produces the same values for the same counters no matter
+how many values were drawn before, or in what order. This keeps renders reproducible across
+calc functions, and lets a whole block of values be computed in one vectorizable loop.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "cpudispatch.hpp"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Represents the generator of one unit. mCounter is the index of the next group of four outputs.
+struct CounterRNG {
+    uint32 mKey[2];
+    uint64 mCounter;
+};
+
+// Computes the four outputs for a counter. stream separates independent sequences that share a key.
+static inline void philox(const uint32 key[2], uint64 counter, uint32 stream, uint32 out[4]) {
+    uint32 c0 = static_cast<uint32>(counter);
+    uint32 c1 = static_cast<uint32>(counter >> 32);
+    uint32 c2 = stream;
+    uint32 c3 = 0;
+    uint32 k0 = key[0];
+    uint32 k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64 p0 = static_cast<uint64>(PHILOX_M0) * c0;
+        uint64 p1 = static_cast<uint64>(PHILOX_M1) * c2;
+        uint32 n0 = static_cast<uint32>(p1 >> 32) ^ c1 ^ k0;
+        uint32 n2 = static_cast<uint32>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<uint32>(p1);
+        c3 = static_cast<uint32>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Converts an output to a uniform float in [0, 1)
+static inline float rngUniform(uint32 x) {
+    return static_cast<float>(x >> 8) * (1.f / 16777216.f);
+}
+
+// Converts an output to a uniform integer in [0, scale), like RGen::irand
+static inline int rngInt(uint32 x, int scale) {
+    return static_cast<int>((static_cast<uint64>(x) * static_cast<uint32>(sc_max(scale, 0))) >> 32);
+}
+
+// Scales a uniform float from rngFill to an integer in [0, scale). scale must be positive.
+static inline int rngScale(float u, int scale) {
+    return sc_min(static_cast<int>(u * scale), scale - 1);
+}
+
+// Sets the key from a seed and restarts the sequence
+static inline void rngSeed(CounterRNG* rng, uint32 seed) {
+    rng->mKey[0] = seed;
+    rng->mKey[1] = seed ^ 0x5DEECE66u;
+    rng->mCounter = 0;
+}
+
+// Seeds the generator from input seedInput. If the input is missing (older SynthDefs) or negative,
+// the seed is drawn from the server's generator instead so that each unit gets a different sequence.
+static inline void rngInit(Unit* unit, CounterRNG* rng, int seedInput) {
+    float seed = static_cast<int>(unit->mNumInputs) > seedInput ? IN0(seedInput) : -1.f;
+    if (seed >= 0.f) {
+        rngSeed(rng, static_cast<uint32>(seed));
+    } else {
+        rngSeed(rng, unit->mParent->mRGen->trand());
+    }
+}
+
+// Fills out with n uniform floats in [0, 1) and advances the counter. Each iteration of the main
+// loop is independent of the others, so the compiler can run several counters at once in SIMD lanes.
+static CPU_KERNEL_INLINE void rngFill_kernel(CounterRNG* rng, float* out, int n) {
+    int numGroups = n / 4;
+    for (int i = 0; i < numGroups; i++) {
+        uint32 r[4];
+        philox(rng->mKey, rng->mCounter + i, 0, r);
+        out[4 * i] = rngUniform(r[0]);
+        out[4 * i + 1] = rngUniform(r[1]);
+        out[4 * i + 2] = rngUniform(r[2]);
+        out[4 * i + 3] = rngUniform(r[3]);
+    }
+    rng->mCounter += numGroups;
+    if (n > 4 * numGroups) {
+        uint32 r[4];
+        philox(rng->mKey, rng->mCounter++, 0, r);
+        for (int i = 4 * numGroups; i < n; i++) {
+            out[i] = rngUniform(r[i - 4 * numGroups]);
+        }
+    }
+}
+
+CPU_DISPATCH_KERNEL(rngFill, (CounterRNG* rng, float* out, int n), (rng, out, n))
+
+// Fills out with n uniform floats in [0, 1) and advances the counter
+static inline void rngFill(CounterRNG* rng, float* out, int n) {
+    rngFill_impl(rng, out, n);
+}
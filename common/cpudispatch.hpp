@@ -0,0 +1,104 @@
+/*
+File: cpudispatch.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the runtime CPU dispatch for the hot kernels. Each kernel is compiled once for
+the portable baseline (SSE2 on x86) and again for AVX2 and AVX-512, and PluginLoad points it at the
+best version the CPU supports. This lets one portable binary still use the wide vector units on
+servers that have them. On other compilers and architectures only the baseline is built.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Workflow:
+// 1. Write the kernel body as a CPU_KERNEL_INLINE function named <name>_kernel that returns void.
+// 2. Use CPU_DISPATCH_KERNEL(name, params, args) to compile it for every ISA level. This defines
+//    the pointer <name>_impl, which callers go through, and <name>_select().
+// 3. In PluginLoad, call <name>_select(cpuDetectLevel()) for each kernel the plugin uses.
+// A kernel that the compiler cannot vectorize on its own can instead define <name>_baseline,
+// <name>_avx2 and <name>_avx512 by hand and use CPU_DISPATCH_SELECT(name, params).
+// Build with -ffp-contract=off. Otherwise the compiler fuses multiplies and adds into FMA
+// instructions in the AVX-512 versions, and their results drift from the baseline's.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(SC_PLUGINS_NO_DISPATCH)
+#define CPU_DISPATCH 1
+#include <immintrin.h>
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,avx2")))
+#else
+#define CPU_DISPATCH 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_KERNEL_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define CPU_KERNEL_INLINE __forceinline
+#else
+#define CPU_KERNEL_INLINE inline
+#endif
+
+// Instruction set levels, from the most portable
+enum CpuLevel {
+    CPU_LEVEL_BASELINE = 0,
+    CPU_LEVEL_AVX2 = 1,
+    CPU_LEVEL_AVX512 = 2
+};
+
+// Gets the highest level that both the CPU and the operating system support
+static inline int cpuDetectLevel() {
+#if CPU_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return CPU_LEVEL_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return CPU_LEVEL_AVX2;
+    }
+#endif
+    return CPU_LEVEL_BASELINE;
+}
+
+#if CPU_DISPATCH
+
+#define CPU_DISPATCH_SELECT(name, params) \
+    static void (*name##_impl) params = name##_baseline; \
+    static inline void name##_select(int level) { \
+        name##_impl = level >= CPU_LEVEL_AVX512 ? name##_avx512 \
+            : level >= CPU_LEVEL_AVX2 ? name##_avx2 : name##_baseline; \
+    }
+
+#define CPU_DISPATCH_KERNEL(name, params, args) \
+    static void name##_baseline params { name##_kernel args; } \
+    CPU_TARGET_AVX2 static void name##_avx2 params { name##_kernel args; } \
+    CPU_TARGET_AVX512 static void name##_avx512 params { name##_kernel args; } \
+    CPU_DISPATCH_SELECT(name, params)
+
+#else
+
+#define CPU_DISPATCH_SELECT(name, params) \
+    static void (*name##_impl) params = name##_baseline; \
+    static inline void name##_select(int level) {}
+
+#define CPU_DISPATCH_KERNEL(name, params, args) \
+    static void name##_baseline params { name##_kernel args; } \
+    CPU_DISPATCH_SELECT(name, params)
+
+#endif
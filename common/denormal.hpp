@@ -0,0 +1,82 @@
+/*
+File: denormal.hpp
+Author: Jeff Martin
+
+Description:
+This file contains a scope that flushes denormal numbers to zero. Arithmetic on denormals
+(values below about 1e-38) can be a hundred times slower than on normal numbers, and spectral
+state that decays toward zero, such as a frozen magnitude history, produces a lot of them.
+The servers normally set these modes for the audio thread already, but a host is not required
+to, so calc functions that are prone to denormals set them for their own duration.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DENORMAL_SSE 1
+// Flush-to-zero (FTZ) and denormals-are-zero (DAZ)
+#define DENORMAL_SSE_FLAGS 0x8040u
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define DENORMAL_AARCH64 1
+// The FZ bit of FPCR, which covers both results and inputs
+#define DENORMAL_AARCH64_FLAGS (1ull << 24)
+#endif
+
+// Flushes denormal results and inputs to zero until the end of the scope, then restores the
+// previous mode. The mode is only written when it differs, since writing it stalls the pipeline.
+struct DenormalScope {
+#if defined(DENORMAL_SSE)
+    unsigned int mSaved;
+
+    DenormalScope() : mSaved(_mm_getcsr()) {
+        if ((mSaved & DENORMAL_SSE_FLAGS) != DENORMAL_SSE_FLAGS) {
+            _mm_setcsr(mSaved | DENORMAL_SSE_FLAGS);
+        }
+    }
+
+    ~DenormalScope() {
+        if ((mSaved & DENORMAL_SSE_FLAGS) != DENORMAL_SSE_FLAGS) {
+            _mm_setcsr(mSaved);
+        }
+    }
+#elif defined(DENORMAL_AARCH64)
+    uint64_t mSaved;
+
+    DenormalScope() {
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(mSaved));
+        if (!(mSaved & DENORMAL_AARCH64_FLAGS)) {
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved | DENORMAL_AARCH64_FLAGS));
+        }
+    }
+
+    ~DenormalScope() {
+        if (!(mSaved & DENORMAL_AARCH64_FLAGS)) {
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved));
+        }
+    }
+#else
+    // Other architectures keep their mode
+    DenormalScope() {}
+#endif
+
+    DenormalScope(const DenormalScope&) = delete;
+    DenormalScope& operator=(const DenormalScope&) = delete;
+};
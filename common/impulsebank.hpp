@@ -0,0 +1,121 @@
+/*
+File: impulsebank.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the phasor bank shared by the ImpulseDropoutBank and ImpulseJitterBank UGens.
+The state of every stream is kept in structure-of-arrays form so that the per-block update
+runs over all streams at once in SIMD lanes, and only the impulse positions are visited per stream.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "cpudispatch.hpp"
+
+// Workflow:
+// 1. Allocate impulseBankSize(numStreams) bytes and hand them to impulseBankInit().
+// 2. Each block, write the phase increment of every stream to bank->inc and call impulseBankAdvance().
+//    PluginLoad should call impulseBankAdvance_select() so that this uses the best version for the CPU.
+//    This advances all of the phasors to the end of the block in one vectorizable pass.
+// 3. Call impulseBankForEachImpulse() for each stream to visit the sample indices of its impulses.
+
+// Represents a bank of independent phasors. phase is the start of the allocation.
+struct ImpulseBank {
+    int numStreams;
+    double* phase;     // phase of each stream in cycles
+    double* inc;       // phase increment of each stream per sample
+    double* progress;  // phase at the start of the block, measured in the direction of travel
+    double* rate;      // absolute phase increment, limited to one cycle per sample
+    int* numImpulses;  // number of impulses of each stream in the current block
+};
+
+// Gets the number of bytes of memory a bank of numStreams phasors needs
+inline size_t impulseBankSize(int numStreams) {
+    return numStreams * (4 * sizeof(double) + sizeof(int));
+}
+
+// Lays out the bank arrays in the provided memory
+inline void impulseBankInit(ImpulseBank* bank, void* memory, int numStreams) {
+    double* arrays = static_cast<double*>(memory);
+    bank->numStreams = numStreams;
+    bank->phase = arrays;
+    bank->inc = arrays + numStreams;
+    bank->progress = arrays + 2 * numStreams;
+    bank->rate = arrays + 3 * numStreams;
+    bank->numImpulses = reinterpret_cast<int*>(arrays + 4 * numStreams);
+}
+
+// Sets the initial phase of a stream the same way Impulse does. An initial phase of 0
+// produces an impulse on the first sample.
+inline void impulseBankSetPhase(ImpulseBank* bank, int stream, double phaseOffset) {
+    double phase = sc_wrap(phaseOffset, 0.0, 1.0);
+    if (phase == 0.0 && bank->inc[stream] >= 0.0) {
+        phase = 1.0; // positive frequency trigger/wrap position
+    }
+    bank->phase[stream] = phase;
+}
+
+// Advances every phasor in the bank by inNumSamples and counts the impulses of each stream.
+// The phase is measured in the direction of travel, so a stream wraps whenever its progress
+// reaches 1 regardless of the sign of its frequency. This loop has no branches between streams
+// so that the compiler can vectorize it.
+static CPU_KERNEL_INLINE void impulseBankAdvance_kernel(ImpulseBank* bank, int inNumSamples) {
+    int numStreams = bank->numStreams;
+    double* phase = bank->phase;
+    const double* inc = bank->inc;
+    double* progress = bank->progress;
+    double* rate = bank->rate;
+    int* numImpulses = bank->numImpulses;
+    for (int k = 0; k < numStreams; k++) {
+        bool negative = inc[k] < 0.0;
+        double r = sc_max(negative ? 1.0 - phase[k] : phase[k], 0.0);
+        double a = sc_min(negative ? -inc[k] : inc[k], 1.0);
+        // Progress at the last sample of the block. Every whole cycle reached is one impulse.
+        double last = r + (inNumSamples - 1) * a;
+        int count = static_cast<int>(last);
+        double end = last - count + a;
+        progress[k] = r;
+        rate[k] = a;
+        numImpulses[k] = count;
+        phase[k] = negative ? 1.0 - end : end;
+    }
+}
+
+CPU_DISPATCH_KERNEL(impulseBankAdvance, (ImpulseBank* bank, int inNumSamples), (bank, inNumSamples))
+
+// Advances every phasor in the bank by inNumSamples and counts the impulses of each stream
+inline void impulseBankAdvance(ImpulseBank* bank, int inNumSamples) {
+    impulseBankAdvance_impl(bank, inNumSamples);
+}
+
+// Calls impulseFunc with the sample index of each impulse of a stream in the current block
+template <typename ImpulseFunc>
+inline void impulseBankForEachImpulse(const ImpulseBank* bank, int stream, int inNumSamples, ImpulseFunc impulseFunc) {
+    int count = bank->numImpulses[stream];
+    if (count <= 0) {
+        return;
+    }
+    double r = bank->progress[stream];
+    double period = 1.0 / bank->rate[stream];
+    for (int j = 1; j <= count; j++) {
+        // The impulse is at the first sample where the progress reaches j cycles
+        int xxn = j <= r ? 0 : static_cast<int>(sc_ceil((j - r) * period));
+        impulseFunc(sc_clip(xxn, 0, inNumSamples - 1));
+    }
+}
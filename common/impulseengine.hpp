@@ -0,0 +1,437 @@
+/*
+File: impulseengine.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the impulse generator shared by the ImpulseDropout, ImpulseJitter and
+ImpulseJitterDropout UGens. The calc functions are templates over the input rates and over
+a dropout policy, a jitter policy and an output policy, so each UGen only instantiates the
+behavior it needs.
+
+Copyright © 2025 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "arrayheap.hpp"
+#include "blit.hpp"
+#include "counterrng.hpp"
+#include "profile.hpp"
+#include "rtcheck.hpp"
+#define HEAP_MAX_SIZE 1024
+
+// This is a copy of the static function from LFUGens.cpp in server/plugins.
+// It detects if a phasor is out-of-bounds, triggers, and wraps [0, 1].
+static inline float testWrapPhase(double prev_inc, double& phase) {
+    if (prev_inc < 0.f) { // negative freqs
+        if (phase <= 0.f) {
+            phase += 1.f;
+            if (phase <= 0.f) { // catch large phase jumps
+                phase -= sc_ceil(phase);
+            }
+            return 1.f;
+        } else {
+            return 0.f;
+        }
+    } else { // positive freqs
+        if (phase >= 1.f) {
+            phase -= 1.f;
+            if (phase >= 1.f) {
+                phase -= sc_floor(phase);
+            }
+            return 1.f;
+        } else {
+            return 0.f;
+        }
+    }
+}
+
+// Returns the number of samples until a phasor with the given phase, increment and per-sample
+// increment slope next reaches its wrap point, or maxSamples if it does not wrap before then.
+// After m samples the phase is phase + m * inc + incSlope * m * (m + 1) / 2, so the crossing is the
+// smallest non-negative root of a quadratic in m. The increment must not change sign.
+static inline int samplesUntilWrap(double phase, double inc, double incSlope, int maxSamples) {
+    // Write the crossing condition as a * m^2 + b * m + c >= 0 for either direction
+    double dir = inc < 0.0 ? -1.0 : 1.0;
+    double a = dir * incSlope * 0.5;
+    double b = dir * (inc + incSlope * 0.5);
+    double c = inc < 0.0 ? -phase : phase - 1.0;
+    if (c >= 0.0) {
+        return 0;
+    }
+    double disc = b * b - 4.0 * a * c;
+    if (disc < 0.0) {
+        return maxSamples;
+    }
+    double denom = b + sqrt(disc);
+    if (denom <= 0.0) {
+        return maxSamples;
+    }
+    double root = -2.0 * c / denom;
+    if (root >= maxSamples) {
+        return maxSamples;
+    }
+
+    // Correct for rounding so that the result agrees with evaluating the phase directly
+    int m = static_cast<int>(sc_ceil(root));
+    while (m > 0 && a * (m - 1) * (m - 1) + b * (m - 1) + c >= 0.0) {
+        m--;
+    }
+    while (m < maxSamples && a * m * m + b * m + c < 0.0) {
+        m++;
+    }
+    return m;
+}
+
+// Advances the phasor from sample xxn to the end of the block, jumping directly from one wrap to
+// the next instead of testing every sample, and calls impulseFunc with the index of each impulse.
+// This makes the cost proportional to the number of impulses rather than the block size.
+// The increment must not change sign within the block.
+template <typename ImpulseFunc>
+static inline void advancePhaseByWraps(double& phase, double& inc, double incSlope, int xxn, int inNumSamples, ImpulseFunc impulseFunc) {
+    while (xxn < inNumSamples) {
+        int m = samplesUntilWrap(phase, inc, incSlope, inNumSamples - xxn);
+        phase += m * inc + incSlope * 0.5 * m * (m + 1);
+        inc += m * incSlope;
+        xxn += m;
+        if (xxn >= inNumSamples) {
+            break;
+        }
+        if (testWrapPhase(inc, phase) > 0.5f) {
+            impulseFunc(xxn);
+        }
+        inc += incSlope;
+        phase += inc;
+        xxn++;
+    }
+}
+
+// Gets how far before the current sample the phasor reached its wrap point, in BLIT_FRAC_BITS
+// fixed point. phase is the phase just after wrapping and inc is the increment that crossed it.
+static inline int wrapFraction(double phase, double inc) {
+    double dist = inc < 0.0 ? 1.0 - phase : phase;
+    double rate = sc_abs(inc);
+    if (dist >= rate) {
+        return 0; // the phase offset jumped past the wrap point
+    }
+    return static_cast<int>(dist / rate * BLIT_FRAC_ONE);
+}
+
+// The state shared by the impulse UGens. Inputs 0 and 1 are always the frequency and phase.
+struct ImpulseUnit : public Unit {
+    double mPhase, mPhaseOffset, mPhaseIncrement;
+    float mFreqMul;
+    float mTail[BLIT_LENGTH]; // band-limited impulses that extend past the current block
+    CounterRNG mRNG;          // one counter per impulse, so dropout and jitter do not depend on the calc function
+};
+
+// The state of an impulse UGen that jitters its impulses
+struct ImpulseHeapUnit : public ImpulseUnit {
+    IntMinHeap mImpulseHeap;
+};
+
+// Dropout policy that keeps every impulse
+struct NoDropout {
+    NoDropout(ImpulseUnit* unit) {}
+    bool drop(uint32 rand) { return false; }
+};
+
+// Dropout policy that randomly drops the fraction of impulses given by input DropInput
+template <int DropInput>
+struct Dropout {
+    float mDropProb;
+    Dropout(ImpulseUnit* unit) : mDropProb(IN0(DropInput)) {}
+    bool drop(uint32 rand) { return rngUniform(rand) < mDropProb; }
+};
+
+// Output policy that writes each impulse as a single sample of 1
+struct ImpulseWriter {
+    float* mOut;
+    ImpulseWriter(ImpulseUnit* unit, float* out, int inNumSamples) : mOut(out) {}
+    void write(int xxn, int frac) { mOut[xxn] = 1.f; }
+};
+
+// Output policy that writes each impulse as a band-limited kernel at its sub-sample position.
+// frac is how far before sample xxn the impulse falls, in BLIT_FRAC_BITS fixed point.
+// The part of a kernel past the end of the block is overlap-added into the unit's tail.
+struct BandLimitedWriter {
+    float* mOut;
+    float* mTail;
+    int mNumSamples;
+
+    BandLimitedWriter(ImpulseUnit* unit, float* out, int inNumSamples) {
+        mOut = out;
+        mTail = unit->mTail;
+        mNumSamples = inNumSamples;
+
+        // Mix in the kernels left over from the previous block, then move the rest of the tail up
+        int numTail = sc_min(inNumSamples, BLIT_LENGTH);
+        for (int i = 0; i < numTail; i++) {
+            out[i] += mTail[i];
+        }
+        for (int i = 0; i < BLIT_LENGTH; i++) {
+            mTail[i] = i + inNumSamples < BLIT_LENGTH ? mTail[i + inNumSamples] : 0.f;
+        }
+    }
+
+    void write(int xxn, int frac) {
+        for (int k = 0; k < BLIT_LENGTH; k++) {
+            float val = blitLookup(k * BLIT_FRAC_ONE + frac);
+            int idx = xxn + k;
+            if (idx < mNumSamples) {
+                mOut[idx] += val;
+            } else {
+                mTail[idx - mNumSamples] += val;
+            }
+        }
+    }
+};
+
+// Jitter policy that writes each impulse on the sample where the phasor wraps
+struct NoJitter {
+    template <typename Writer>
+    NoJitter(ImpulseUnit* unit, Writer& writer, int inNumSamples) {}
+
+    template <typename Writer>
+    void place(uint32 rand, Writer& writer, int xxn, int frac) { writer.write(xxn, frac); }
+
+    // Discards the state left by the priming call in the Ctor
+    static void reset(ImpulseUnit* unit) {}
+};
+
+// Jitter policy that moves each impulse later by a random number of samples, up to the fraction
+// of HEAP_MAX_SIZE given by input JitterInput. Impulses moved past the end of the block wait
+// in the unit's heap. The heap holds sample positions in BLIT_FRAC_BITS fixed point so that
+// band-limited impulses keep their sub-sample position.
+template <int JitterInput>
+struct Jitter {
+    IntMinHeap* mHeap;
+    int mNumSamples;
+    int mJitterWidth;
+    size_t mHeapEffectiveSize;
+
+    template <typename Writer>
+    Jitter(ImpulseHeapUnit* unit, Writer& writer, int inNumSamples) {
+        mHeap = &unit->mImpulseHeap;
+        mNumSamples = inNumSamples;
+        // The maximum distance an impulse can be displaced
+        mJitterWidth = static_cast<int>(IN0(JitterInput) * mHeap->maxSize);
+        // Higher frequencies may keep fewer impulses waiting
+        mHeapEffectiveSize = static_cast<size_t>(HEAP_MAX_SIZE / (12 * sc_max(sc_log2(sc_abs(IN0(0))), 1.f)));
+
+        // Update the impulse table indices
+        int blockEnd = inNumSamples << BLIT_FRAC_BITS;
+        for (size_t i = 1; i < mHeap->size; i++) {
+            mHeap->heap[i] -= blockEnd;
+        }
+
+        // Retrieve impulses for this block. Every impulse in the heap was placed past the end of an
+        // earlier block, so none should be negative, but an index before the output must never be written.
+        while (heapPeek(mHeap) < blockEnd && mHeap->size > 1) {
+            int pos = sc_max(heapPop(mHeap), 0);
+            writer.write(pos >> BLIT_FRAC_BITS, pos & (BLIT_FRAC_ONE - 1));
+        }
+    }
+
+    template <typename Writer>
+    void place(uint32 rand, Writer& writer, int xxn, int frac) {
+        int idx = rngInt(rand, mJitterWidth) + xxn;
+        if (idx < mNumSamples) {
+            writer.write(idx, frac);
+        } else if (mHeap->size < mHeapEffectiveSize) {
+            heapInsert(mHeap, (idx << BLIT_FRAC_BITS) + frac);
+        }
+    }
+
+    // Discards the state left by the priming call in the Ctor. Impulses it placed in the heap are
+    // relative to a block of 1 sample, so they would land before the start of the first real block.
+    static void reset(ImpulseHeapUnit* unit) {
+        unit->mImpulseHeap.size = 1;
+    }
+};
+
+// Computes a block of impulses. FreqRate and OffRate are the rates of the frequency and phase inputs.
+// With an audio-rate frequency the phase offset may be at any rate. With a control-rate or scalar
+// frequency the phase offset is either scalar or control-rate.
+template <typename UnitType, int FreqRate, int OffRate, typename DropPolicy, typename JitterPolicy, typename Writer>
+void impulseEngineNext(UnitType* unit, int inNumSamples) {
+    float* out = OUT(0);
+
+    // Collect UGen state
+    double phase = unit->mPhase;
+    double inc = unit->mPhaseIncrement;
+    double prevOff = unit->mPhaseOffset;
+    float freqMul = unit->mFreqMul;
+
+    // Zero out the output buffer. Only the impulses are written below.
+    for (int xxn = 0; xxn < inNumSamples; xxn++) {
+        out[xxn] = 0.f;
+    }
+
+    Writer writer(unit, out, inNumSamples);
+    DropPolicy dropout(unit);
+    JitterPolicy jitter(unit, writer, inNumSamples);
+    CounterRNG* rng = &unit->mRNG;
+    auto impulse = [&](int xxn) {
+        // Each impulse uses the next counter, with one value for dropout and one for jitter
+        uint32 rand[4];
+        philox(rng->mKey, rng->mCounter++, 0, rand);
+        // Drop the impulse if necessary
+        if (!dropout.drop(rand[0])) {
+            jitter.place(rand[1], writer, xxn, wrapFraction(phase, inc));
+        }
+    };
+
+    if (FreqRate == calc_FullRate && OffRate == calc_FullRate) {
+        float* freqIn = IN(0);
+        float* offIn = IN(1);
+        for (int xxn = 0; xxn < inNumSamples; xxn++) {
+            if (testWrapPhase(inc, phase) > 0.5f) {
+                impulse(xxn);
+            }
+            double off = static_cast<double>(offIn[xxn]);
+            double offInc = off - prevOff;
+            phase += offInc;
+            testWrapPhase(inc, phase);
+            inc = freqIn[xxn] * freqMul;
+            phase += inc;
+            prevOff = off;
+        }
+    } else if (FreqRate == calc_FullRate) {
+        float* freqIn = IN(0);
+        double off = OffRate == calc_ScalarRate ? prevOff : IN0(1);
+        double offSlope = CALCSLOPE(off, prevOff);
+        // The frequency is only known to be constant if every sample of the block is the same
+        bool freqSteady = true;
+        for (int xxn = 1; xxn < inNumSamples; xxn++) {
+            if (freqIn[xxn] != freqIn[0]) {
+                freqSteady = false;
+                break;
+            }
+        }
+        if (offSlope == 0.0 && freqSteady) {
+            // The first sample is tested with the previous increment. After that the increment is
+            // constant, so the remaining impulses can be found without stepping through every sample.
+            if (testWrapPhase(inc, phase) > 0.5f) {
+                impulse(0);
+            }
+            inc = freqIn[0] * freqMul;
+            phase += inc;
+            advancePhaseByWraps(phase, inc, 0.0, 1, inNumSamples, impulse);
+        } else {
+            for (int xxn = 0; xxn < inNumSamples; xxn++) {
+                if (testWrapPhase(inc, phase) > 0.5f) {
+                    impulse(xxn);
+                }
+                phase += offSlope;
+                testWrapPhase(inc, phase);
+                inc = freqIn[xxn] * freqMul;
+                phase += inc;
+            }
+        }
+        prevOff = off;
+    } else {
+        double nextInc = IN0(0) * freqMul;
+        double off = OffRate == calc_ScalarRate ? prevOff : IN0(1);
+        double incSlope = CALCSLOPE(nextInc, inc);
+        double offSlope = CALCSLOPE(off, prevOff);
+        if (offSlope == 0.0 && (inc < 0.0) == (nextInc < 0.0)) {
+            // With a steady phase offset and no change of sign, jump from one impulse to the next
+            advancePhaseByWraps(phase, inc, incSlope, 0, inNumSamples, impulse);
+        } else {
+            for (int xxn = 0; xxn < inNumSamples; xxn++) {
+                if (testWrapPhase(inc, phase) > 0.5f) {
+                    impulse(xxn);
+                }
+                if (offSlope != 0.0) {
+                    phase += offSlope;
+                    testWrapPhase(inc, phase);
+                }
+                inc += incSlope;
+                phase += inc;
+            }
+        }
+        inc = nextInc;
+        prevOff = off;
+    }
+
+    unit->mPhase = phase;
+    unit->mPhaseOffset = prevOff;
+    unit->mPhaseIncrement = inc;
+}
+
+// Selects the calc function for the input rates
+template <typename UnitType, typename DropPolicy, typename JitterPolicy, typename Writer>
+UnitCalcFunc impulseEngineSelect(UnitType* unit) {
+    if (INRATE(0) == calc_FullRate) {
+        switch (INRATE(1)) {
+        case calc_ScalarRate:
+            return (UnitCalcFunc)impulseEngineNext<UnitType, calc_FullRate, calc_ScalarRate, DropPolicy, JitterPolicy, Writer>;
+        case calc_BufRate:
+            return (UnitCalcFunc)impulseEngineNext<UnitType, calc_FullRate, calc_BufRate, DropPolicy, JitterPolicy, Writer>;
+        default:
+            return (UnitCalcFunc)impulseEngineNext<UnitType, calc_FullRate, calc_FullRate, DropPolicy, JitterPolicy, Writer>;
+        }
+    } else if (INRATE(1) == calc_ScalarRate) {
+        return (UnitCalcFunc)impulseEngineNext<UnitType, calc_BufRate, calc_ScalarRate, DropPolicy, JitterPolicy, Writer>;
+    } else {
+        return (UnitCalcFunc)impulseEngineNext<UnitType, calc_BufRate, calc_BufRate, DropPolicy, JitterPolicy, Writer>;
+    }
+}
+
+// Initializes the phasor and selects the calc function for the input rates and output mode.
+// Input BandLimitInput selects band-limited impulses and input SeedInput seeds the generator.
+// SynthDefs built before these inputs existed omit them.
+template <typename UnitType, typename DropPolicy, typename JitterPolicy, int BandLimitInput, int SeedInput>
+void impulseEngineCtor(UnitType* unit) {
+    unit->mFreqMul = static_cast<float>(unit->mRate->mSampleDur);
+    unit->mPhaseIncrement = IN0(0) * unit->mFreqMul;
+    unit->mPhaseOffset = IN0(1);
+    for (int i = 0; i < BLIT_LENGTH; i++) {
+        unit->mTail[i] = 0.f;
+    }
+    rngInit(unit, &unit->mRNG, SeedInput);
+
+    double initOff = unit->mPhaseOffset;
+    double initInc = unit->mPhaseIncrement;
+    double initPhase = sc_wrap(initOff, 0.0, 1.0);
+
+    // Initial phase offset of 0 means output of 1 on first sample.
+    // Set phase to wrap point to trigger impulse on first sample
+    if (initPhase == 0.0 && initInc >= 0.0) {
+        initPhase = 1.0; // positive frequency trigger/wrap position
+    }
+    unit->mPhase = initPhase;
+
+    UnitCalcFunc func;
+    if (unit->mNumInputs > BandLimitInput && IN0(BandLimitInput) > 0.f) {
+        func = impulseEngineSelect<UnitType, DropPolicy, JitterPolicy, BandLimitedWriter>(unit);
+    } else {
+        func = impulseEngineSelect<UnitType, DropPolicy, JitterPolicy, ImpulseWriter>(unit);
+    }
+    SETCALC(*func);
+    func(unit, 1);
+
+    unit->mPhase = initPhase;
+    unit->mPhaseOffset = initOff;
+    unit->mPhaseIncrement = initInc;
+    unit->mRNG.mCounter = 0;
+    for (int i = 0; i < BLIT_LENGTH; i++) {
+        unit->mTail[i] = 0.f;
+    }
+    JitterPolicy::reset(unit);
+}
@@ -0,0 +1,206 @@
+/*
+File: profile.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the optional per-UGen profiler. When the plugins are built with
+SC_PLUGINS_PROFILE defined, every calc function installed with SETCALC is wrapped with a
+timestamp counter read before and after it runs, and the cost of each block is added to the
+statistics of its unit type. A plugin command prints the statistics on the NRT thread, through
+statscmd.hpp. Without SC_PLUGINS_PROFILE this file defines nothing but an empty profileInit(),
+and the calc functions are installed exactly as before.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+
+// Workflow:
+// 1. Include this file after the SuperCollider headers. In profiling builds it replaces SETCALC,
+//    DefineSimpleUnit and DefineDtorUnit with versions that register and wrap each unit type.
+// 2. Call profileInit(ft, name) in PluginLoad. This defines the plugin command scPluginsStats_<name>,
+//    which prints the statistics of every unit type in the plugin:
+//      s.sendMsg(\cmd, "scPluginsStats_PV");
+//    Every plugin is a separate library with its own statistics, so each one has its own command.
+
+#ifdef SC_PLUGINS_PROFILE
+
+#include "calcwrap.hpp"
+#include "statscmd.hpp"
+#include <atomic>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILE_UNIT_NAME "cycles"
+static inline uint64 profileNow() {
+    return __rdtsc();
+}
+#else
+#include <chrono>
+#define PROFILE_UNIT_NAME "ns"
+static inline uint64 profileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// The histogram has four buckets per power of two, so a percentile is within 25% of the true value
+#define PROFILE_SUB_BUCKET_BITS 2
+#define PROFILE_NUM_BUCKETS (64 << PROFILE_SUB_BUCKET_BITS)
+
+// Statistics of one unit type. Calc functions on any DSP thread update them with relaxed atomic operations,
+// and the NRT thread reads them.
+struct ProfileStats {
+    const char* mName;
+    ProfileStats* mNext;
+    std::atomic<uint64> mNumBlocks;
+    std::atomic<uint64> mTotal;
+    std::atomic<uint64> mMax;
+    std::atomic<uint64> mHistogram[PROFILE_NUM_BUCKETS];
+};
+
+// The unit types registered in this plugin
+static ProfileStats* gProfileStats = nullptr;
+
+// Gets the index of the most significant set bit of a nonzero value
+static inline int profileMsb(uint64 x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
+
+static inline int profileBucket(uint64 x) {
+    if (x < (1 << PROFILE_SUB_BUCKET_BITS)) {
+        return static_cast<int>(x);
+    }
+    int msb = profileMsb(x);
+    int sub = static_cast<int>(x >> (msb - PROFILE_SUB_BUCKET_BITS)) & ((1 << PROFILE_SUB_BUCKET_BITS) - 1);
+    return ((msb - PROFILE_SUB_BUCKET_BITS + 1) << PROFILE_SUB_BUCKET_BITS) + sub;
+}
+
+// Gets the largest value that falls in a bucket
+static inline uint64 profileBucketMax(int bucket) {
+    if (bucket < (1 << PROFILE_SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    int shift = (bucket >> PROFILE_SUB_BUCKET_BITS) - 1;
+    uint64 sub = bucket & ((1 << PROFILE_SUB_BUCKET_BITS) - 1);
+    return (((1ull << PROFILE_SUB_BUCKET_BITS) + sub + 1) << shift) - 1;
+}
+
+static inline void profileRecord(ProfileStats& stats, uint64 cost) {
+    stats.mNumBlocks.fetch_add(1, std::memory_order_relaxed);
+    stats.mTotal.fetch_add(cost, std::memory_order_relaxed);
+    uint64 max = stats.mMax.load(std::memory_order_relaxed);
+    while (cost > max && !stats.mMax.compare_exchange_weak(max, cost, std::memory_order_relaxed)) {
+    }
+    stats.mHistogram[profileBucket(cost)].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Holds the statistics of a unit type
+template <typename UnitType>
+struct ProfileSlot {
+    static ProfileStats sStats;
+};
+
+template <typename UnitType>
+ProfileStats ProfileSlot<UnitType>::sStats;
+
+// Times each block of a calc function
+struct ProfileHook {
+    template <typename UnitType>
+    static void call(UnitCalcFunc func, Unit* unit, int inNumSamples) {
+        uint64 start = profileNow();
+        func(unit, inNumSamples);
+        profileRecord(ProfileSlot<UnitType>::sStats, profileNow() - start);
+    }
+};
+
+// Adds a unit type to the plugin's statistics. This runs in PluginLoad.
+template <typename UnitType>
+static void profileRegister(const char* name) {
+    ProfileStats& stats = ProfileSlot<UnitType>::sStats;
+    stats.mName = name;
+    stats.mNext = gProfileStats;
+    gProfileStats = &stats;
+}
+
+// Prints the statistics of every unit type in the plugin (NRT thread, in stage 2 of the command)
+static inline void profilePrintStats(InterfaceTable* table) {
+    for (ProfileStats* stats = gProfileStats; stats; stats = stats->mNext) {
+        uint64 numBlocks = stats->mNumBlocks.load(std::memory_order_relaxed);
+        if (numBlocks == 0) {
+            (*table->fPrint)("%s: no blocks\n", stats->mName);
+            continue;
+        }
+        // The histogram is read while DSP threads may still add to it, so it is only approximately in
+        // step with numBlocks. Sum it to find the 99th percentile.
+        uint64 counts[PROFILE_NUM_BUCKETS];
+        uint64 numCounted = 0;
+        for (int i = 0; i < PROFILE_NUM_BUCKETS; i++) {
+            counts[i] = stats->mHistogram[i].load(std::memory_order_relaxed);
+            numCounted += counts[i];
+        }
+        uint64 p99 = 0;
+        uint64 numBelow = 0;
+        for (int i = 0; i < PROFILE_NUM_BUCKETS; i++) {
+            numBelow += counts[i];
+            if (numBelow * 100 >= numCounted * 99) {
+                p99 = profileBucketMax(i);
+                break;
+            }
+        }
+        double mean = static_cast<double>(stats->mTotal.load(std::memory_order_relaxed)) / numBlocks;
+        (*table->fPrint)("%s: %llu blocks, mean %.0f, p99 %llu, max %llu " PROFILE_UNIT_NAME " per block\n",
+            stats->mName, static_cast<unsigned long long>(numBlocks), mean, static_cast<unsigned long long>(p99),
+            static_cast<unsigned long long>(stats->mMax.load(std::memory_order_relaxed)));
+    }
+}
+
+static inline void profileInit(InterfaceTable* table, const char* pluginName) {
+    char cmdName[64];
+    snprintf(cmdName, sizeof(cmdName), "scPluginsStats_%s", pluginName);
+    statsCmdDefine<profilePrintStats>(table, cmdName);
+}
+
+#undef SETCALC
+#define SETCALC(func) (unit->mCalcFunc = CalcWrap<CALC_WRAP_UNIT_TYPE, ProfileHook>::wrap((UnitCalcFunc)&func))
+
+#undef DefineSimpleUnit
+#define DefineSimpleUnit(name) \
+    profileRegister<name>(#name); \
+    (*ft->fDefineUnit)(#name, sizeof(name), (UnitCtorFunc)&name##_Ctor, 0, 0);
+
+#undef DefineDtorUnit
+#define DefineDtorUnit(name) \
+    profileRegister<name>(#name); \
+    (*ft->fDefineUnit)(#name, sizeof(name), (UnitCtorFunc)&name##_Ctor, (UnitDtorFunc)&name##_Dtor, 0);
+
+#else
+
+static inline void profileInit(InterfaceTable* table, const char* pluginName) {}
+
+#endif
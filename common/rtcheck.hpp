@@ -0,0 +1,121 @@
+/*
+File: rtcheck.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the plugin side of the real-time safety checker. When the plugins are built with
+SC_PLUGINS_RT_CHECK defined, every Ctor, calc function and Dtor tells the checker library
+(tools/rtcheck) which unit type is running, and the library reports any heap allocation, mutex
+lock or write() made on that thread in the meantime. Without the library loaded, the hooks do
+nothing. Without SC_PLUGINS_RT_CHECK this file defines nothing.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+
+// Workflow:
+// 1. Include this file after the SuperCollider headers, after profile.hpp if both are included.
+//    In checking builds it replaces SETCALC, DefineSimpleUnit and DefineDtorUnit.
+// 2. Run the server with the checker library preloaded:
+//      LD_PRELOAD=build/librtcheck.so scsynth -u 57110
+//    Each call it catches is printed with the unit type, the stage and a backtrace. Set
+//    RTCHECK_ABORT=1 to abort on the first one instead.
+// 3. With SC_PLUGINS_TESTS also on, the ctest test rtcheck runs the differential test with the
+//    library preloaded, and fails on any call it reports.
+
+#ifdef SC_PLUGINS_RT_CHECK
+
+#ifdef SC_PLUGINS_PROFILE
+#error "SC_PLUGINS_RT_CHECK and SC_PLUGINS_PROFILE cannot be used together"
+#endif
+
+#include "calcwrap.hpp"
+#include <dlfcn.h>
+
+typedef void (*RtCheckEnterFunc)(const char* unitName, const char* stage);
+typedef void (*RtCheckLeaveFunc)();
+
+// The entry points of the checker library, or null if it is not loaded
+static RtCheckEnterFunc gRtCheckEnter = nullptr;
+static RtCheckLeaveFunc gRtCheckLeave = nullptr;
+
+// The name of a unit type, set when the type is defined in PluginLoad
+template <typename UnitType>
+struct RtCheckName {
+    static const char* sName;
+};
+
+template <typename UnitType>
+const char* RtCheckName<UnitType>::sName = "";
+
+// Marks the current thread as running real-time code for the lifetime of the scope
+struct RtCheckScope {
+    RtCheckScope(const char* unitName, const char* stage) {
+        if (gRtCheckEnter)
+            gRtCheckEnter(unitName, stage);
+    }
+    ~RtCheckScope() {
+        if (gRtCheckLeave)
+            gRtCheckLeave();
+    }
+};
+
+struct RtCheckHook {
+    template <typename UnitType>
+    static void call(UnitCalcFunc func, Unit* unit, int inNumSamples) {
+        RtCheckScope scope(RtCheckName<UnitType>::sName, "calc");
+        func(unit, inNumSamples);
+    }
+};
+
+template <typename UnitType, void (*Ctor)(UnitType*)>
+static void rtCheckCtor(UnitType* unit) {
+    RtCheckScope scope(RtCheckName<UnitType>::sName, "Ctor");
+    Ctor(unit);
+}
+
+template <typename UnitType, void (*Dtor)(UnitType*)>
+static void rtCheckDtor(UnitType* unit) {
+    RtCheckScope scope(RtCheckName<UnitType>::sName, "Dtor");
+    Dtor(unit);
+}
+
+// Names a unit type and finds the checker library. This runs in PluginLoad.
+template <typename UnitType>
+static void rtCheckRegister(const char* name) {
+    RtCheckName<UnitType>::sName = name;
+    gRtCheckEnter = (RtCheckEnterFunc)dlsym(RTLD_DEFAULT, "scPluginsRtCheckEnter");
+    gRtCheckLeave = (RtCheckLeaveFunc)dlsym(RTLD_DEFAULT, "scPluginsRtCheckLeave");
+}
+
+#undef SETCALC
+#define SETCALC(func) (unit->mCalcFunc = CalcWrap<CALC_WRAP_UNIT_TYPE, RtCheckHook>::wrap((UnitCalcFunc)&func))
+
+#undef DefineSimpleUnit
+#define DefineSimpleUnit(name) \
+    rtCheckRegister<name>(#name); \
+    (*ft->fDefineUnit)(#name, sizeof(name), (UnitCtorFunc)&rtCheckCtor<name, &name##_Ctor>, 0, 0);
+
+#undef DefineDtorUnit
+#define DefineDtorUnit(name) \
+    rtCheckRegister<name>(#name); \
+    (*ft->fDefineUnit)(#name, sizeof(name), (UnitCtorFunc)&rtCheckCtor<name, &name##_Ctor>, \
+        (UnitDtorFunc)&rtCheckDtor<name, &name##_Dtor>, 0);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+File: rtlog.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the real-time log. Print() writes to the console straight away, which can
+block the audio thread, so Ctors, calc functions and Dtors use rtLog() instead. It copies a
+fixed-size record (unit type, node ID, message and up to two numbers) into a lock-free queue,
+and the NRT thread formats and prints the records. If the queue is full, the record is dropped
+and counted rather than waiting.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include <atomic>
+#include <cstdio>
+
+// Workflow:
+// 1. Call rtLogInit(ft) in PluginLoad.
+// 2. On the audio thread, log with a string literal and up to two numbers, formatted with %g:
+//      rtLog(unit, "ImpulseJitter", "RT memory allocation failed");
+//      rtLog(unit, "RubberBandPS", "expected %g outputs", numChannels + 3);
+//    The strings are not copied, so they must outlive the plugin.
+// Print() is still the right choice on the NRT thread, for example in asynchronous command stages
+// and buffer fill commands.
+
+// The number of records the queue holds. It only needs to absorb bursts, such as many voices
+// failing to allocate in one block.
+#define RTLOG_CAPACITY 256
+#define RTLOG_MAX_ARGS 2
+
+struct RtLogRecord {
+    std::atomic<uint32> mSequence;  // tells the writers and the reader whose turn the record is
+    const char* mUnitName;
+    const char* mMessage;
+    int32 mNodeID;
+    double mArgs[RTLOG_MAX_ARGS];
+};
+
+// A bounded queue that any number of DSP threads can write and the NRT thread reads. Each record's
+// sequence number is its position in the queue while it is free, and one more once it is written.
+struct RtLog {
+    InterfaceTable* mTable = nullptr;
+    RtLogRecord mRecords[RTLOG_CAPACITY];
+    std::atomic<uint32> mWritePos{0};
+    uint32 mReadPos = 0;                 // only used by the NRT thread
+    std::atomic<uint32> mNumDropped{0};
+    std::atomic<bool> mDrainPending{false};
+
+    RtLog() {
+        for (uint32 i = 0; i < RTLOG_CAPACITY; i++) {
+            mRecords[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Claims a record, or returns null if the queue is full
+    RtLogRecord* claim() {
+        uint32 pos = mWritePos.load(std::memory_order_relaxed);
+        for (;;) {
+            RtLogRecord* record = &mRecords[pos % RTLOG_CAPACITY];
+            int32 diff = static_cast<int32>(record->mSequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (mWritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return record;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = mWritePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Gets the next written record, or null if there is none. Call release() when done with it.
+    RtLogRecord* next() {
+        RtLogRecord* record = &mRecords[mReadPos % RTLOG_CAPACITY];
+        int32 diff = static_cast<int32>(record->mSequence.load(std::memory_order_acquire) - (mReadPos + 1));
+        return diff < 0 ? nullptr : record;
+    }
+
+    void release(RtLogRecord* record) {
+        record->mSequence.store(mReadPos + RTLOG_CAPACITY, std::memory_order_release);
+        mReadPos++;
+    }
+};
+
+// The log of this plugin
+static RtLog gRtLog;
+
+// Prints every record in the queue (NRT thread)
+static void rtLogDrain(FifoMsg* msg) {
+    InterfaceTable* table = gRtLog.mTable;
+    // Clear the flag first, so that a record written during the drain sends another message
+    gRtLog.mDrainPending.store(false, std::memory_order_seq_cst);
+    while (RtLogRecord* record = gRtLog.next()) {
+        char message[256];
+        snprintf(message, sizeof(message), record->mMessage, record->mArgs[0], record->mArgs[1]);
+        (*table->fPrint)("%s (node %d): %s\n", record->mUnitName, record->mNodeID, message);
+        gRtLog.release(record);
+    }
+    uint32 numDropped = gRtLog.mNumDropped.exchange(0, std::memory_order_relaxed);
+    if (numDropped > 0) {
+        (*table->fPrint)("%u log messages were dropped because the log was full\n", numDropped);
+    }
+}
+
+static inline void rtLogInit(InterfaceTable* table) {
+    gRtLog.mTable = table;
+}
+
+// Logs a message from the audio thread. This never blocks or allocates.
+static inline void rtLog(Unit* unit, const char* unitName, const char* message, double arg0 = 0.0, double arg1 = 0.0) {
+    RtLogRecord* record = gRtLog.claim();
+    if (!record) {
+        gRtLog.mNumDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    record->mUnitName = unitName;
+    record->mMessage = message;
+    record->mNodeID = unit->mParent->mNode.mID;
+    record->mArgs[0] = arg0;
+    record->mArgs[1] = arg1;
+    record->mSequence.store(record->mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // Wake the NRT thread, unless a drain is already on its way
+    if (!gRtLog.mDrainPending.exchange(true, std::memory_order_seq_cst)) {
+        FifoMsg msg;
+        msg.Set(unit->mWorld, rtLogDrain, nullptr, nullptr);
+        if (!(*gRtLog.mTable->fSendMsgFromRT)(unit->mWorld, msg)) {
+            gRtLog.mDrainPending.store(false, std::memory_order_relaxed);
+        }
+    }
+}
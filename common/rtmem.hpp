@@ -0,0 +1,162 @@
+/*
+File: rtmem.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the RT memory accounting. Every allocation the plugins make from the server's
+real-time pool goes through rtMemAlloc() and rtMemFree(), which keep the live bytes, peak live
+bytes, number of allocations and number of failures of each unit type. A plugin command prints
+the figures on the NRT thread, through statscmd.hpp, so the RT memory a server needs for a given
+number of voices can be measured rather than guessed.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "rtlog.hpp"
+#include "statscmd.hpp"
+#include <atomic>
+#include <cstdio>
+
+// Workflow:
+// 1. Call rtMemInit(ft, name) in PluginLoad. This also sets up the real-time log, and defines the
+//    plugin command scPluginsMemory_<name>, which prints the figures of every unit type that has
+//    allocated memory:
+//      s.sendMsg(\cmd, "scPluginsMemory_PV");
+// 2. Allocate with rtMemAlloc(unit, "UnitName", size) instead of RTAlloc. A failure is counted and
+//    logged here, so the caller only has to recover from it, usually by clearing its outputs.
+// 3. Free with rtMemFree(world, ptr) instead of RTFree. It takes null, and it works from any
+//    thread that RTFree does, such as the cleanup stage of an asynchronous command.
+// Memory the plugins take from the heap on the NRT thread, such as the RubberBand shifters, does
+// not come from the RT pool and is not counted.
+
+// Each allocation starts with a header that records its size and unit type. 16 bytes keeps the
+// memory after it aligned for any scalar or SSE type.
+#define RTMEM_HEADER_SIZE 16
+
+// Figures of one unit type. Allocations on any DSP thread update them with relaxed atomic
+// operations, and the NRT thread reads them.
+struct RtMemStats {
+    const char* mName;
+    RtMemStats* mNext;
+    std::atomic<bool> mRegistered;
+    std::atomic<int64> mLive;
+    std::atomic<int64> mPeak;
+    std::atomic<uint64> mNumAllocs;
+    std::atomic<uint64> mNumFailures;
+};
+
+struct RtMemHeader {
+    RtMemStats* mStats;
+    size_t mSize;
+};
+
+static_assert(sizeof(RtMemHeader) <= RTMEM_HEADER_SIZE, "the header must fit in front of the memory");
+
+static InterfaceTable* gRtMemTable = nullptr;
+// The unit types of this plugin that have allocated memory
+static std::atomic<RtMemStats*> gRtMemStats{nullptr};
+
+// Holds the figures of a unit type
+template <typename UnitType>
+struct RtMemSlot {
+    static RtMemStats sStats;
+};
+
+template <typename UnitType>
+RtMemStats RtMemSlot<UnitType>::sStats;
+
+// Adds a unit type to the list on its first allocation. This never blocks, so it is safe on any DSP thread.
+static inline void rtMemRegister(RtMemStats& stats, const char* name) {
+    if (stats.mRegistered.load(std::memory_order_relaxed) || stats.mRegistered.exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+    stats.mName = name;
+    RtMemStats* head = gRtMemStats.load(std::memory_order_relaxed);
+    do {
+        stats.mNext = head;
+    } while (!gRtMemStats.compare_exchange_weak(head, &stats, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// Allocates size bytes from the RT pool on behalf of a unit, counted in the figures of SlotType, or
+// returns null and logs the failure. Memory that is not owned by one unit type, such as the
+// scratch arena's fallback, names its own slot type.
+template <typename SlotType>
+static inline void* rtMemAllocAs(Unit* unit, const char* unitName, size_t size) {
+    RtMemStats& stats = RtMemSlot<SlotType>::sStats;
+    rtMemRegister(stats, unitName);
+    char* memory = static_cast<char*>((*gRtMemTable->fRTAlloc)(unit->mWorld, size + RTMEM_HEADER_SIZE));
+    if (!memory) {
+        stats.mNumFailures.fetch_add(1, std::memory_order_relaxed);
+        rtLog(unit, unitName, "RT memory allocation of %g bytes failed, increase the server's memSize", static_cast<double>(size));
+        return nullptr;
+    }
+    RtMemHeader* header = reinterpret_cast<RtMemHeader*>(memory);
+    header->mStats = &stats;
+    header->mSize = size;
+    int64 live = stats.mLive.fetch_add(static_cast<int64>(size), std::memory_order_relaxed) + static_cast<int64>(size);
+    int64 peak = stats.mPeak.load(std::memory_order_relaxed);
+    while (live > peak && !stats.mPeak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    stats.mNumAllocs.fetch_add(1, std::memory_order_relaxed);
+    return memory + RTMEM_HEADER_SIZE;
+}
+
+// Allocates size bytes from the RT pool on behalf of a unit, or returns null and logs the failure
+template <typename UnitType>
+static inline void* rtMemAlloc(UnitType* unit, const char* unitName, size_t size) {
+    return rtMemAllocAs<UnitType>(unit, unitName, size);
+}
+
+// Frees memory from rtMemAlloc()
+static inline void rtMemFree(World* world, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    RtMemHeader* header = reinterpret_cast<RtMemHeader*>(static_cast<char*>(ptr) - RTMEM_HEADER_SIZE);
+    header->mStats->mLive.fetch_sub(static_cast<int64>(header->mSize), std::memory_order_relaxed);
+    (*gRtMemTable->fRTFree)(world, header);
+}
+
+// Prints the figures of every unit type in the plugin (NRT thread, in stage 2 of the command)
+static inline void rtMemPrintStats(InterfaceTable* table) {
+    RtMemStats* head = gRtMemStats.load(std::memory_order_acquire);
+    if (!head) {
+        (*table->fPrint)("no RT memory allocated\n");
+        return;
+    }
+    int64 totalLive = 0;
+    for (RtMemStats* stats = head; stats; stats = stats->mNext) {
+        int64 live = stats->mLive.load(std::memory_order_relaxed);
+        totalLive += live;
+        (*table->fPrint)("%s: %lld bytes live, %lld bytes peak, %llu allocations, %llu failed\n", stats->mName,
+            static_cast<long long>(live), static_cast<long long>(stats->mPeak.load(std::memory_order_relaxed)),
+            static_cast<unsigned long long>(stats->mNumAllocs.load(std::memory_order_relaxed)),
+            static_cast<unsigned long long>(stats->mNumFailures.load(std::memory_order_relaxed)));
+    }
+    (*table->fPrint)("total: %lld bytes live, plus %d bytes of header per allocation\n",
+        static_cast<long long>(totalLive), RTMEM_HEADER_SIZE);
+}
+
+static inline void rtMemInit(InterfaceTable* table, const char* pluginName) {
+    gRtMemTable = table;
+    rtLogInit(table);
+    char cmdName[64];
+    snprintf(cmdName, sizeof(cmdName), "scPluginsMemory_%s", pluginName);
+    statsCmdDefine<rtMemPrintStats>(table, cmdName);
+}
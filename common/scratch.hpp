@@ -0,0 +1,128 @@
+/*
+File: scratch.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the scratch arena, which lends calc functions temporary memory that only
+lives until they return, such as a frame of random values. The arenas are allocated once at
+plugin load, so a unit no longer needs its own RTAlloc copy of arrays it does not keep between
+calls, and the RT pool does not grow or fragment with the number of voices.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "rtmem.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Workflow:
+// 1. Call rtMemInit(ft, name) and then scratchInit(ft) in PluginLoad.
+// 2. In a calc function, open a scope and borrow arrays from it:
+//      ScratchScope scratch(unit);
+//      float* rand = scratch.alloc<float>(numbins + 2);
+//    Everything borrowed is given back when the scope ends, so nothing may be kept across calls.
+//    alloc() returns null only if the memory cannot be found anywhere, like RTAlloc.
+// PluginLoad has no World, so the arenas belong to the plugin rather than to a World. scsynth runs
+// one audio thread and only needs one. Under supernova each DSP thread borrows its own, and if
+// they are all in use, or a request does not fit, the scope falls back to the RT pool. The fallback
+// goes through rtMemAlloc, so it shows up as "Scratch" in the plugin's memory figures.
+
+#ifdef SUPERNOVA
+#define SCRATCH_NUM_ARENAS 8
+#else
+#define SCRATCH_NUM_ARENAS 1
+#endif
+// Enough for the random values of a frame at FFT sizes up to 32768
+#define SCRATCH_SIZE (128 * 1024)
+// Every array starts on its own cache line
+#define SCRATCH_ALIGN 64
+#define SCRATCH_MAX_FALLBACKS 4
+
+// Each arena sits on its own cache line, so that DSP threads claiming neighbors do not share one
+struct alignas(SCRATCH_ALIGN) ScratchArena {
+    std::atomic<bool> mBusy{false};
+    char* mData = nullptr;
+};
+
+static ScratchArena gScratchArenas[SCRATCH_NUM_ARENAS];
+
+// Allocates the arenas (NRT thread). They are never freed, since the server may use them until it exits.
+static inline void scratchInit(InterfaceTable* table) {
+    for (int i = 0; i < SCRATCH_NUM_ARENAS; i++) {
+        char* memory = static_cast<char*>(malloc(SCRATCH_SIZE + SCRATCH_ALIGN));
+        if (!memory) {
+            continue;
+        }
+        // Touch every page now, so the audio thread does not take page faults on first use
+        memset(memory, 0, SCRATCH_SIZE + SCRATCH_ALIGN);
+        uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+        gScratchArenas[i].mData = memory + (SCRATCH_ALIGN - address % SCRATCH_ALIGN) % SCRATCH_ALIGN;
+    }
+}
+
+// Borrows an arena for the rest of a calc function
+struct ScratchScope {
+    Unit* mUnit;
+    ScratchArena* mArena = nullptr;
+    size_t mUsed = 0;
+    void* mFallbacks[SCRATCH_MAX_FALLBACKS];
+    int mNumFallbacks = 0;
+
+    explicit ScratchScope(Unit* unit) : mUnit(unit) {
+        for (int i = 0; i < SCRATCH_NUM_ARENAS; i++) {
+            ScratchArena* arena = &gScratchArenas[i];
+            if (arena->mData && !arena->mBusy.exchange(true, std::memory_order_acquire)) {
+                mArena = arena;
+                break;
+            }
+        }
+    }
+
+    ~ScratchScope() {
+        for (int i = 0; i < mNumFallbacks; i++) {
+            rtMemFree(mUnit->mWorld, mFallbacks[i]);
+        }
+        if (mArena) {
+            mArena->mBusy.store(false, std::memory_order_release);
+        }
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    // Borrows an uninitialized array of count elements. Arrays from the arena are aligned to a cache line.
+    template<typename T> T* alloc(size_t count) {
+        size_t size = (count * sizeof(T) + SCRATCH_ALIGN - 1) & ~static_cast<size_t>(SCRATCH_ALIGN - 1);
+        if (mArena && SCRATCH_SIZE - mUsed >= size) {
+            T* array = reinterpret_cast<T*>(mArena->mData + mUsed);
+            mUsed += size;
+            return array;
+        }
+        if (mNumFallbacks == SCRATCH_MAX_FALLBACKS) {
+            return nullptr;
+        }
+        void* memory = rtMemAllocAs<ScratchArena>(mUnit, "Scratch", size);
+        if (memory) {
+            mFallbacks[mNumFallbacks++] = memory;
+        }
+        return static_cast<T*>(memory);
+    }
+};
@@ -0,0 +1,59 @@
+/*
+File: statscmd.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the plugin commands that print statistics, such as the profiler's and the RT
+memory accounting's. A plugin command runs on the thread that reads the server's OSC commands,
+which in scsynth is the RT thread, so it must not print or do much work itself. The command here
+only starts an asynchronous command, whose stage 2 gathers and prints the statistics on the NRT
+thread.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include <cstdio>
+
+// Workflow:
+// 1. Write a function that prints the statistics with table->fPrint. It runs on the NRT thread.
+// 2. Call statsCmdDefine<printFunc>(ft, cmdName) in PluginLoad. When the command arrives, the
+//    server runs the print function in stage 2 of an asynchronous command, and replies with
+//    [/done, scPluginsStats] when it has finished.
+
+typedef void (*StatsPrintFunc)(InterfaceTable* table);
+
+// Prints the statistics (NRT thread)
+template <StatsPrintFunc printFunc>
+static inline bool statsCmdStage2(World* world, void* cmdData) {
+    printFunc(static_cast<InterfaceTable*>(cmdData));
+    return true;
+}
+
+// Defers the printing to the NRT thread (RT thread)
+template <StatsPrintFunc printFunc>
+static inline void statsCmd(World* world, void* userData, struct sc_msg_iter* args, void* replyAddr) {
+    InterfaceTable* table = static_cast<InterfaceTable*>(userData);
+    (*table->fDoAsynchronousCommand)(world, replyAddr, "scPluginsStats", table, statsCmdStage2<printFunc>, nullptr,
+        nullptr, nullptr, 0, nullptr);
+}
+
+template <StatsPrintFunc printFunc>
+static inline void statsCmdDefine(InterfaceTable* table, const char* cmdName) {
+    (*table->fDefinePlugInCmd)(cmdName, statsCmd<printFunc>, table);
+}
@@ -0,0 +1,129 @@
+/*
+File: bench_ringbuffer.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the throughput benchmark of the ring buffers. It moves the same number of
+samples through RingBuffer::writeBlock/readBlock and through SpscRingBuffer::write/read at
+several block sizes on one thread, then through SpscRingBuffer with the producer and consumer
+on separate threads, and prints millions of samples per second for each. RingBuffer is not
+safe across threads, so it only has the single-thread figure.
+
+Run it by hand from the build directory:
+    ./bench_ringbuffer [millions of samples per case, default 100]
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ringbuffer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Both rings hold this many blocks, as RubberBandPS sizes its rings
+#define BENCH_PADDING 4
+
+// Keeps the compiler from dropping the reads
+static volatile float gSink;
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double benchRingBuffer(size_t block, size_t total) {
+    RingBuffer<float> ring(block, block, BENCH_PADDING / 2);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    std::vector<float> in(block, 1.f);
+    std::vector<float> out(block);
+    float sum = 0.f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < total; done += block) {
+        ring.writeBlock(in.data(), block);
+        if (ring.isReadReady()) {
+            ring.readBlock(out.data());
+            sum += out[block - 1];
+        }
+    }
+    double elapsed = seconds(start);
+    gSink = sum;
+    return total / elapsed / 1e6;
+}
+
+static double benchSpsc(size_t block, size_t total) {
+    SpscRingBuffer<float> ring(block * BENCH_PADDING);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    std::vector<float> in(block, 1.f);
+    std::vector<float> out(block);
+    float sum = 0.f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < total; done += block) {
+        ring.write(in.data(), block);
+        if (ring.read(out.data(), block) == RingResult::Ok) {
+            sum += out[block - 1];
+        }
+    }
+    double elapsed = seconds(start);
+    gSink = sum;
+    return total / elapsed / 1e6;
+}
+
+static double benchSpscThreaded(size_t block, size_t total) {
+    SpscRingBuffer<float> ring(block * BENCH_PADDING);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        std::vector<float> in(block, 1.f);
+        for (size_t done = 0; done < total;) {
+            if (ring.write(in.data(), block) == RingResult::Ok) {
+                done += block;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::vector<float> out(block);
+    float sum = 0.f;
+    for (size_t done = 0; done < total;) {
+        if (ring.read(out.data(), block) == RingResult::Ok) {
+            sum += out[block - 1];
+            done += block;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    double elapsed = seconds(start);
+    gSink = sum;
+    return total / elapsed / 1e6;
+}
+
+int main(int argc, char** argv) {
+    size_t total = static_cast<size_t>(argc > 1 ? atof(argv[1]) * 1e6 : 100e6);
+    const size_t blocks[] = {16, 64, 256, 1024};
+    printf("block  RingBuffer  SpscRingBuffer  SpscRingBuffer (2 threads)   [Msamples/s]\n");
+    for (size_t block : blocks) {
+        size_t blockTotal = total / block * block;
+        printf("%5zu  %10.1f  %14.1f  %26.1f\n", block, benchRingBuffer(block, blockTotal), benchSpsc(block, blockTotal),
+            benchSpscThreaded(block, blockTotal));
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+File: bench_silence.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the benchmark of the PV units on silence. It loads the built plugins into the
+batchrender host and runs a chain of PV_MagSqueeze, PV_MagMirror, PV_CFreeze, PV_MagSqueeze1 and
+PV_BinRandomMask through the batchrender STFT, once over digital silence and once over a signal.
+It prints the best CPU time of several runs for each, and the number of NaN samples in the output.
+The silent-frame fast path should make the silence case cheaper than the signal case, and the
+output of silence should be silence.
+
+Run it by hand from the build directory:
+    ./bench_silence <plugin dir> [seconds of audio per run, default 20] [runs, default 5]
+To compare with an earlier version of the PV units, build that version's plugins and point the
+benchmark at them.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "host.hpp"
+#include "stft.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#define BENCH_SAMPLE_RATE 48000.0
+#define BENCH_FFT_SIZE 2048
+#define BENCH_HOP (BENCH_FFT_SIZE / 2)
+#define BENCH_BLOCK_SIZE 1024
+
+// The chain, with the inputs of each unit after its FFT buffer, as given to batchrender with -u
+struct BenchUnit {
+    const char* mName;
+    std::vector<float> mArgs;
+};
+
+static const BenchUnit gChain[] = {
+    {"PV_MagSqueeze", {0.f, 1.f}},
+    {"PV_MagMirror", {}},
+    {"PV_CFreeze", {0.f, 4.f}},
+    {"PV_MagSqueeze1", {}},
+    {"PV_BinRandomMask", {0.f, 0.5f, 0.f, 0.f}},
+};
+
+// Runs the chain over a signal and returns the CPU time in seconds. numNaNs counts the NaN output samples.
+static double runChain(const std::vector<float>& input, size_t& numNaNs) {
+    Host host(BENCH_SAMPLE_RATE, 64, 1, 1000, 1);
+    hostBufAlloc(&host.mBufs[0], 1, BENCH_FFT_SIZE, BENCH_SAMPLE_RATE);
+    std::vector<std::unique_ptr<HostUnit>> units;
+    for (const BenchUnit& spec : gChain) {
+        std::string error;
+        std::unique_ptr<HostUnit> unit = host.createUnit(spec.mName, calc_BufRate, spec.mArgs, 1, true, 1, error);
+        if (!unit) {
+            fprintf(stderr, "bench_silence: %s\n", error.c_str());
+            exit(1);
+        }
+        units.push_back(std::move(unit));
+    }
+    Stft stft;
+    stft.init(BENCH_FFT_SIZE, BENCH_HOP);
+    SndBuf* buf = &host.mBufs[0];
+
+    // Runs the chain on one frame and converts the result back to complex bins, as batchrender does
+    auto runFrame = [&](float* frame) {
+        std::copy(frame, frame + buf->samples, buf->data);
+        buf->coord = coord_Complex;
+        for (auto& unit : units) {
+            unit->input(0)[0] = 0.f;
+            unit->run();
+        }
+        if (buf->coord == coord_Polar) {
+            SCPolarBuf* polar = reinterpret_cast<SCPolarBuf*>(buf->data);
+            int numbins = (buf->samples - 2) >> 1;
+            for (int i = 0; i < numbins; i++) {
+                frame[2 * i + 2] = polar->bin[i].mag * std::cos(polar->bin[i].phase);
+                frame[2 * i + 3] = polar->bin[i].mag * std::sin(polar->bin[i].phase);
+            }
+            frame[0] = polar->dc;
+            frame[1] = polar->nyq;
+        } else {
+            std::copy(buf->data, buf->data + buf->samples, frame);
+        }
+    };
+
+    std::vector<float> output(BENCH_BLOCK_SIZE);
+    numNaNs = 0;
+    std::clock_t start = std::clock();
+    for (size_t pos = 0; pos + BENCH_BLOCK_SIZE <= input.size(); pos += BENCH_BLOCK_SIZE) {
+        stft.process(input.data() + pos, output.data(), BENCH_BLOCK_SIZE, runFrame);
+        for (float sample : output) {
+            numNaNs += std::isnan(sample) ? 1 : 0;
+        }
+    }
+    return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: bench_silence <plugin dir> [seconds] [runs]\n");
+        return 2;
+    }
+    double seconds = argc > 2 ? atof(argv[2]) : 20.0;
+    int numRuns = argc > 3 ? atoi(argv[3]) : 5;
+    std::string error;
+    if (hostLoadPlugins(argv[1], error) == 0) {
+        fprintf(stderr, "bench_silence: %s\n", error.c_str());
+        return 2;
+    }
+
+    // The signal is a chord with a little noise from a fixed seed, so every run sees the same input
+    size_t numSamples = static_cast<size_t>(seconds * BENCH_SAMPLE_RATE) / BENCH_BLOCK_SIZE * BENCH_BLOCK_SIZE;
+    std::vector<float> silence(numSamples, 0.f);
+    std::vector<float> signal(numSamples);
+    uint32 noise = 12345;
+    for (size_t i = 0; i < numSamples; i++) {
+        noise = noise * 1664525u + 1013904223u;
+        double t = i / BENCH_SAMPLE_RATE;
+        signal[i] = static_cast<float>(0.2 * std::sin(2.0 * M_PI * 220.0 * t) + 0.1 * std::sin(2.0 * M_PI * 331.0 * t)
+            + 0.05 * (static_cast<double>(noise) / 4294967296.0 - 0.5));
+    }
+
+    printf("%.1f s of audio, FFT size %d, best of %d runs\n", numSamples / BENCH_SAMPLE_RATE, BENCH_FFT_SIZE, numRuns);
+    printf("input     CPU seconds  NaN samples\n");
+    const char* names[2] = {"silence", "signal"};
+    const std::vector<float>* inputs[2] = {&silence, &signal};
+    for (int i = 0; i < 2; i++) {
+        double best = INFINITY;
+        size_t numNaNs = 0;
+        for (int run = 0; run < numRuns; run++) {
+            best = std::min(best, runChain(*inputs[i], numNaNs));
+        }
+        printf("%-8s  %11.3f  %11zu\n", names[i], best, numNaNs);
+    }
+    return 0;
+}
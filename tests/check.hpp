@@ -0,0 +1,82 @@
+/*
+File: check.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the checks used by the tests. A failed check prints where it failed and
+the test carries on, so one run reports every failure. Each test program returns the result
+of checkExit() from main, which ctest reads as pass or fail.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cmath>
+#include <cstdio>
+
+// Workflow:
+// 1. Write each case as a function that uses CHECK, CHECK_EQ and CHECK_NEAR.
+// 2. Call the cases from main through RUN_TEST, then return checkExit().
+
+static int gCheckFailures = 0;
+static const char* gCheckTest = "";
+
+#define CHECK(cond)                                                                                 \
+    do {                                                                                            \
+        if (!(cond)) {                                                                              \
+            fprintf(stderr, "%s:%d: %s: failed: %s\n", __FILE__, __LINE__, gCheckTest, #cond);      \
+            gCheckFailures++;                                                                       \
+        }                                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                              \
+    do {                                                                                            \
+        double checkA = static_cast<double>(a);                                                     \
+        double checkB = static_cast<double>(b);                                                     \
+        if (!(checkA == checkB)) {                                                                  \
+            fprintf(stderr, "%s:%d: %s: failed: %s == %s (%.9g != %.9g)\n", __FILE__, __LINE__,     \
+                gCheckTest, #a, #b, checkA, checkB);                                                \
+            gCheckFailures++;                                                                       \
+        }                                                                                           \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                                 \
+    do {                                                                                            \
+        double checkA = static_cast<double>(a);                                                     \
+        double checkB = static_cast<double>(b);                                                     \
+        if (!(std::fabs(checkA - checkB) <= (tolerance))) {                                         \
+            fprintf(stderr, "%s:%d: %s: failed: %s ~ %s (%.9g != %.9g)\n", __FILE__, __LINE__,      \
+                gCheckTest, #a, #b, checkA, checkB);                                                \
+            gCheckFailures++;                                                                       \
+        }                                                                                           \
+    } while (0)
+
+#define RUN_TEST(func)                                                                              \
+    do {                                                                                            \
+        gCheckTest = #func;                                                                         \
+        int checkBefore = gCheckFailures;                                                           \
+        func();                                                                                     \
+        printf("%s %s\n", gCheckFailures == checkBefore ? "ok  " : "FAIL", #func);                  \
+    } while (0)
+
+static inline int checkExit() {
+    if (gCheckFailures > 0) {
+        fprintf(stderr, "%d checks failed\n", gCheckFailures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,450 @@
+/*
+File: test_differential.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the differential tests of the calc functions. It loads the built plugins into
+the batchrender host and runs each UGen with the same constant inputs at audio rate, control rate
+and scalar rate, which select different calc functions, and checks that they agree. It also checks
+the outputs against models written out here: loop wraps, the finish trigger, negative rates, the
+start trigger, and jittered and dropped impulses, across several block sizes.
+
+The test takes the plugin directory as its argument:
+    ./test_differential <plugin dir>
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "check.hpp"
+#include "host.hpp"
+#include "impulseengine.hpp"
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+// The impulse tests run at a power of two sample rate with a power of two period, so that the
+// phasor is exact in floating point and every calc function wraps on the same sample.
+#define TEST_SAMPLE_RATE 65536.0
+#define TEST_IMPULSE_FREQ 1024.f
+#define TEST_IMPULSE_PERIOD 64
+#define TEST_FFT_SIZE 256
+
+// Writes the signal inputs of a unit before the block that starts at sample blockStart
+typedef std::function<void(HostUnit& unit, int blockStart, int blockSize)> SetInputs;
+
+// Runs a unit at audio rate for numSamples and returns its first output. On failure the result is empty.
+static std::vector<float> renderUnit(const std::string& name, const std::vector<HostInput>& inputs, int numSamples,
+    int blockSize, const SetInputs& setInputs = nullptr, double sampleRate = TEST_SAMPLE_RATE) {
+    Host host(sampleRate, blockSize, 0, 1000, 1);
+    std::string error;
+    std::unique_ptr<HostUnit> unit = host.createUnit(name, calc_FullRate, inputs, 1, error);
+    if (!unit) {
+        fprintf(stderr, "%s: %s\n", gCheckTest, error.c_str());
+        gCheckFailures++;
+        return std::vector<float>();
+    }
+    std::vector<float> out;
+    for (int blockStart = 0; blockStart < numSamples; blockStart += blockSize) {
+        if (setInputs) {
+            setInputs(*unit, blockStart, blockSize);
+        }
+        unit->run();
+        out.insert(out.end(), unit->output(0), unit->output(0) + blockSize);
+    }
+    out.resize(numSamples);
+    return out;
+}
+
+// Returns the largest difference between two outputs, or infinity if their lengths differ
+static double maxDifference(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size() || a.empty()) {
+        return INFINITY;
+    }
+    double difference = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        difference = std::max(difference, std::fabs(static_cast<double>(a[i]) - b[i]));
+    }
+    return difference;
+}
+
+// Sets a trigger input to 1 on the given samples and to 0 elsewhere. At control rate the trigger
+// is 1 for the whole block that holds the sample, as a trigger from a control-rate UGen would be.
+static void writeTrigger(HostUnit& unit, int index, const std::set<int>& samples, int blockStart, int blockSize) {
+    if (unit.mInputWires[index].mCalcRate == calc_FullRate) {
+        for (int i = 0; i < blockSize; i++) {
+            unit.input(index)[i] = samples.count(blockStart + i) ? 1.f : 0.f;
+        }
+    } else if (unit.mInputWires[index].mCalcRate == calc_BufRate) {
+        auto next = samples.lower_bound(blockStart);
+        unit.input(index)[0] = next != samples.end() && *next < blockStart + blockSize ? 1.f : 0.f;
+    }
+}
+
+// LoopPhasor inputs: trigStart, trigEnd, rate, start, end, loopStart, loopEnd
+static std::vector<HostInput> loopPhasorInputs(int startRate, int endRate, int rateRate, float rate, float start,
+    float end, float loopStart, float loopEnd) {
+    return {{startRate, 0.f}, {endRate, 0.f}, {rateRate, rate}, {calc_ScalarRate, start},
+        {calc_ScalarRate, end}, {calc_ScalarRate, loopStart}, {calc_ScalarRate, loopEnd}};
+}
+
+// Renders a LoopPhasor with triggers on the given samples
+static std::vector<float> renderLoopPhasor(int startRate, int endRate, int rateRate, float rate, float start,
+    float end, float loopStart, float loopEnd, const std::set<int>& startTriggers, const std::set<int>& endTriggers,
+    int numSamples, int blockSize) {
+    return renderUnit("LoopPhasor", loopPhasorInputs(startRate, endRate, rateRate, rate, start, end, loopStart,
+        loopEnd), numSamples, blockSize, [&](HostUnit& unit, int blockStart, int size) {
+            writeTrigger(unit, 0, startTriggers, blockStart, size);
+            writeTrigger(unit, 1, endTriggers, blockStart, size);
+        });
+}
+
+// The three calc functions of LoopPhasor, and the rates of the trigger and rate inputs that select them.
+// _aa and _ak also run with one trigger at audio rate and the other at control or scalar rate.
+struct LoopPhasorVariant {
+    const char* mName;
+    int mStartRate;
+    int mEndRate;
+    int mRateRate;
+};
+
+static const LoopPhasorVariant gLoopPhasorVariants[] = {
+    {"_aa", calc_FullRate, calc_FullRate, calc_FullRate},
+    {"_aa kr triggers", calc_BufRate, calc_BufRate, calc_FullRate},
+    {"_aa scalar trigEnd", calc_FullRate, calc_ScalarRate, calc_FullRate},
+    {"_ak", calc_FullRate, calc_FullRate, calc_BufRate},
+    {"_ak scalar rate", calc_FullRate, calc_FullRate, calc_ScalarRate},
+    {"_ak scalar trigEnd", calc_FullRate, calc_ScalarRate, calc_BufRate},
+    {"_ak kr trigEnd", calc_FullRate, calc_BufRate, calc_BufRate},
+    {"_ak kr trigStart", calc_BufRate, calc_FullRate, calc_BufRate},
+    {"_kk", calc_BufRate, calc_BufRate, calc_BufRate},
+    {"_kk scalar", calc_ScalarRate, calc_ScalarRate, calc_ScalarRate},
+};
+
+static void checkOutput(const char* what, const std::vector<float>& out, const std::vector<float>& expected,
+    double tolerance) {
+    double difference = maxDifference(out, expected);
+    if (!(difference <= tolerance)) {
+        fprintf(stderr, "%s: %s differs by %g\n", gCheckTest, what, difference);
+        gCheckFailures++;
+    }
+}
+
+static void testLoopPhasorRates() {
+    // With constant inputs and no triggers, every calc function produces the same ramp through the loop
+    for (int blockSize : {1, 16, 64}) {
+        std::vector<float> reference = renderLoopPhasor(calc_FullRate, calc_FullRate, calc_FullRate, 0.75f, 0.f, 1000.f,
+            100.f, 300.f, {}, {}, 4096, blockSize);
+        CHECK_EQ(reference[200], 150.f);
+        for (const LoopPhasorVariant& variant : gLoopPhasorVariants) {
+            std::vector<float> out = renderLoopPhasor(variant.mStartRate, variant.mEndRate, variant.mRateRate,
+                0.75f, 0.f, 1000.f, 100.f, 300.f, {}, {}, 4096, blockSize);
+            checkOutput(variant.mName, out, reference, 1e-6);
+        }
+    }
+}
+
+static void testLoopPhasorControlRate() {
+    // A control-rate LoopPhasor moves by rate once per block, so it follows an audio-rate one with
+    // rate / blockSize, sampled at the start of each block. Both land exactly on the loop end.
+    const int blockSize = 64;
+    const int numBlocks = 64;
+    std::vector<float> audio = renderLoopPhasor(calc_FullRate, calc_FullRate, calc_FullRate, 0.5f, 0.f, 1000.f, 128.f,
+        320.f, {}, {}, numBlocks * blockSize, blockSize);
+    Host host(TEST_SAMPLE_RATE, blockSize, 0, 1000, 1);
+    std::string error;
+    std::unique_ptr<HostUnit> unit = host.createUnit("LoopPhasor", calc_BufRate,
+        loopPhasorInputs(calc_BufRate, calc_BufRate, calc_BufRate, 0.5f * blockSize, 0.f, 1000.f, 128.f, 320.f), 1,
+        error);
+    CHECK(unit);
+    if (!unit) {
+        return;
+    }
+    for (int block = 0; block < numBlocks; block++) {
+        unit->run();
+        CHECK_NEAR(unit->output(0)[0], audio[block * blockSize], 1e-4);
+    }
+}
+
+static void testLoopPhasorLoop() {
+    // Rate 1 from 0 reaches the loop end of 40 on sample 40, wraps to the loop start of 20, and
+    // loops from then on, across every block boundary
+    std::vector<float> expected(256);
+    for (int n = 0; n < 256; n++) {
+        expected[n] = static_cast<float>(n < 40 ? n : 20 + (n - 40) % 20);
+    }
+    for (int blockSize : {1, 16, 64}) {
+        for (const LoopPhasorVariant& variant : gLoopPhasorVariants) {
+            std::vector<float> out = renderLoopPhasor(variant.mStartRate, variant.mEndRate, variant.mRateRate,
+                1.f, 0.f, 100.f, 20.f, 40.f, {}, {}, 256, blockSize);
+            checkOutput(variant.mName, out, expected, 0.0);
+        }
+    }
+}
+
+static void testLoopPhasorNegativeRate() {
+    // Outside the loop, a negative rate wraps from start back to end
+    std::vector<float> expected(256);
+    for (int n = 0; n < 256; n++) {
+        expected[n] = static_cast<float>((10 - n % 10) % 10);
+    }
+    for (int blockSize : {1, 16, 64}) {
+        for (const LoopPhasorVariant& variant : gLoopPhasorVariants) {
+            std::vector<float> out = renderLoopPhasor(variant.mStartRate, variant.mEndRate, variant.mRateRate,
+                -1.f, 0.f, 10.f, 20.f, 40.f, {}, {}, 256, blockSize);
+            checkOutput(variant.mName, out, expected, 0.0);
+        }
+    }
+}
+
+static void testLoopPhasorFinish() {
+    // A finish trigger stops the looping, and the phasor then runs to end and holds there. At audio
+    // rate the trigger takes effect on its sample. At control rate it takes effect at the start of
+    // the block that holds it.
+    const int trigger = 37;
+    for (int blockSize : {1, 16, 64}) {
+        for (const LoopPhasorVariant& variant : gLoopPhasorVariants) {
+            if (variant.mEndRate == calc_ScalarRate) {
+                continue;
+            }
+            int finish = variant.mEndRate == calc_FullRate ? trigger : trigger / blockSize * blockSize;
+            std::vector<float> expected(256);
+            for (int n = 0; n < 256; n++) {
+                int looped = n < 20 ? n : 10 + (n - 20) % 10;
+                int atFinish = finish < 20 ? finish : 10 + (finish - 20) % 10;
+                expected[n] = static_cast<float>(n < finish ? looped : std::min(atFinish + n - finish, 50));
+            }
+            std::vector<float> out = renderLoopPhasor(variant.mStartRate, variant.mEndRate, variant.mRateRate,
+                1.f, 0.f, 50.f, 10.f, 20.f, {}, {trigger}, 256, blockSize);
+            checkOutput(variant.mName, out, expected, 0.0);
+        }
+    }
+}
+
+static void testLoopPhasorStart() {
+    // The phasor begins at start. The start trigger follows Phasor: an audio-rate trigger is placed
+    // within its sample, so a trigger that rises from 0 to 1 lands one step past start, on start + rate.
+    // A control-rate trigger jumps to start itself at the start of the block that holds it.
+    // LoopPhasor.schelp documents this.
+    const int trigger = 40;
+    for (int blockSize : {1, 16, 64}) {
+        for (const LoopPhasorVariant& variant : gLoopPhasorVariants) {
+            if (variant.mStartRate == calc_ScalarRate) {
+                continue;
+            }
+            bool audioTrigger = variant.mStartRate == calc_FullRate;
+            int jump = audioTrigger ? trigger : trigger / blockSize * blockSize;
+            float landing = audioTrigger ? 6.f : 5.f;
+            std::vector<float> expected(128);
+            for (int n = 0; n < 128; n++) {
+                expected[n] = n < jump ? 5.f + n : landing + (n - jump);
+            }
+            std::vector<float> out = renderLoopPhasor(variant.mStartRate, variant.mEndRate, variant.mRateRate,
+                1.f, 5.f, 200.f, 150.f, 160.f, {trigger}, {}, 128, blockSize);
+            checkOutput(variant.mName, out, expected, 0.0);
+        }
+    }
+}
+
+// The inputs of the impulse UGens after the frequency and phase, up to the band limit and seed
+struct ImpulseUGen {
+    const char* mName;
+    std::vector<float> mParams;
+    float mJitter;
+    float mDrop;
+};
+
+static const ImpulseUGen gImpulseUGens[] = {
+    {"ImpulseDropout", {0.3f}, 0.f, 0.3f},
+    {"ImpulseJitter", {0.25f}, 0.25f, 0.f},
+    {"ImpulseJitterDropout", {0.25f, 0.3f}, 0.25f, 0.3f},
+};
+
+static std::vector<float> renderImpulse(const ImpulseUGen& ugen, int freqRate, int phaseRate, float phase,
+    bool bandLimit, int numSamples, int blockSize) {
+    std::vector<HostInput> inputs = {{freqRate, TEST_IMPULSE_FREQ}, {phaseRate, phase}};
+    for (float param : ugen.mParams) {
+        inputs.push_back({calc_ScalarRate, param});
+    }
+    inputs.push_back({calc_ScalarRate, bandLimit ? 1.f : 0.f});
+    inputs.push_back({calc_ScalarRate, 7.f});
+    return renderUnit(ugen.mName, inputs, numSamples, blockSize);
+}
+
+// The impulses of an impulse UGen with seed 7, computed from its definition. Impulse k falls on the
+// sample where the phasor wraps, and draws counter k of the generator: the first value decides
+// whether it is dropped, and the second how many samples it is moved later.
+static std::vector<float> modelImpulses(const ImpulseUGen& ugen, float phase, int numSamples) {
+    CounterRNG rng;
+    rngSeed(&rng, 7);
+    int jitterWidth = static_cast<int>(ugen.mJitter * HEAP_MAX_SIZE);
+    int first = phase == 0.f ? 0 : static_cast<int>((1.f - phase) * TEST_IMPULSE_PERIOD);
+    std::vector<float> out(numSamples, 0.f);
+    for (int k = 0; first + k * TEST_IMPULSE_PERIOD < numSamples; k++) {
+        uint32 rand[4];
+        philox(rng.mKey, static_cast<uint64>(k), 0, rand);
+        if (rngUniform(rand[0]) < ugen.mDrop) {
+            continue;
+        }
+        int position = first + k * TEST_IMPULSE_PERIOD + rngInt(rand[1], jitterWidth);
+        if (position < numSamples) {
+            out[position] = 1.f;
+        }
+    }
+    return out;
+}
+
+static void testImpulseRates() {
+    // Every combination of frequency and phase rates selects its own calc function. With constant
+    // inputs they must place the same impulses, plain or band-limited.
+    const int rates[][2] = {
+        {calc_ScalarRate, calc_ScalarRate},
+        {calc_BufRate, calc_ScalarRate},
+        {calc_BufRate, calc_BufRate},
+        {calc_FullRate, calc_ScalarRate},
+        {calc_FullRate, calc_BufRate},
+        {calc_FullRate, calc_FullRate},
+    };
+    for (const ImpulseUGen& ugen : gImpulseUGens) {
+        for (bool bandLimit : {false, true}) {
+            for (float phase : {0.f, 0.25f}) {
+                std::vector<float> reference = renderImpulse(ugen, calc_ScalarRate, calc_ScalarRate, phase, bandLimit,
+                    8192, 64);
+                for (const int* rate : rates) {
+                    std::vector<float> out = renderImpulse(ugen, rate[0], rate[1], phase, bandLimit, 8192, 64);
+                    std::string what = std::string(ugen.mName) + " rates " + std::to_string(rate[0]) + ","
+                        + std::to_string(rate[1]) + (bandLimit ? " band-limited" : "");
+                    checkOutput(what.c_str(), out, reference, 1e-6);
+                }
+            }
+        }
+    }
+}
+
+static void testImpulseModel() {
+    // Jittered impulses that land past the end of a block wait in the unit's heap, so the output
+    // must not depend on the block size
+    for (const ImpulseUGen& ugen : gImpulseUGens) {
+        for (float phase : {0.f, 0.25f}) {
+            std::vector<float> expected = modelImpulses(ugen, phase, 8192);
+            for (int blockSize : {1, 16, 64, 1024}) {
+                for (int freqRate : {calc_ScalarRate, calc_FullRate}) {
+                    std::vector<float> out = renderImpulse(ugen, freqRate, calc_ScalarRate, phase, false, 8192, blockSize);
+                    std::string what = std::string(ugen.mName) + " block " + std::to_string(blockSize);
+                    checkOutput(what.c_str(), out, expected, 0.0);
+                }
+            }
+        }
+    }
+}
+
+// A PV UGen with its inputs after the FFT buffer. Inputs marked in mBuffers are FFT buffer numbers.
+struct PVUGen {
+    const char* mName;
+    std::vector<float> mParams;
+    std::vector<bool> mBuffers;
+};
+
+static const PVUGen gPVUGens[] = {
+    {"PV_CFreeze", {1.f, 4.f, 7.f}, {false, false, false}},
+    {"PV_BinRandomMask", {0.5f, 0.5f, -1.f, 0.f, 7.f}, {false, false, false, false, false}},
+    {"PV_MagMirror", {}, {}},
+    {"PV_MagSqueeze", {0.2f, 0.7f}, {false, false}},
+    {"PV_MagSqueeze1", {}, {}},
+    {"PV_MagXFade", {1.f, 0.3f}, {true, false}},
+};
+
+// Fills an FFT buffer with a frame of complex bins that changes from frame to frame
+static void fillFrame(SndBuf* buf, int frame, int salt) {
+    buf->coord = coord_Complex;
+    for (int i = 0; i < buf->samples; i++) {
+        buf->data[i] = static_cast<float>(std::sin(0.37 * i + 1.3 * frame + salt) * (1.0 + 0.5 * std::cos(0.11 * i)));
+    }
+}
+
+// Runs a PV UGen for numFrames frames with its control inputs at the given rate, and returns
+// every frame it leaves in its buffer, converted to complex bins
+static std::vector<float> renderPV(const PVUGen& ugen, int paramRate, int numFrames) {
+    Host host(TEST_SAMPLE_RATE, 64, 2, 1000, 1);
+    for (SndBuf& buf : host.mBufs) {
+        hostBufAlloc(&buf, 1, TEST_FFT_SIZE, TEST_SAMPLE_RATE);
+    }
+    std::vector<HostInput> inputs = {{calc_BufRate, 0.f}};
+    for (size_t i = 0; i < ugen.mParams.size(); i++) {
+        inputs.push_back({ugen.mBuffers[i] ? calc_BufRate : paramRate, ugen.mParams[i]});
+    }
+    std::string error;
+    std::unique_ptr<HostUnit> unit = host.createUnit(ugen.mName, calc_BufRate, inputs, 1, error);
+    if (!unit) {
+        fprintf(stderr, "%s: %s\n", gCheckTest, error.c_str());
+        gCheckFailures++;
+        return std::vector<float>();
+    }
+    std::vector<float> out;
+    for (int frame = 0; frame < numFrames; frame++) {
+        fillFrame(&host.mBufs[0], frame, 0);
+        fillFrame(&host.mBufs[1], frame, 1);
+        unit->run();
+        SndBuf* buf = &host.mBufs[0];
+        if (buf->coord == coord_Polar) {
+            SCPolarBuf* polar = reinterpret_cast<SCPolarBuf*>(buf->data);
+            int numbins = (buf->samples - 2) >> 1;
+            out.push_back(polar->dc);
+            out.push_back(polar->nyq);
+            for (int i = 0; i < numbins; i++) {
+                out.push_back(polar->bin[i].mag * std::cos(polar->bin[i].phase));
+                out.push_back(polar->bin[i].mag * std::sin(polar->bin[i].phase));
+            }
+        } else {
+            out.insert(out.end(), buf->data, buf->data + buf->samples);
+        }
+    }
+    return out;
+}
+
+static void testPVRates() {
+    // The PV UGens read their control inputs once per frame, so scalar and control-rate inputs with
+    // the same values must give the same frames
+    for (const PVUGen& ugen : gPVUGens) {
+        std::vector<float> reference = renderPV(ugen, calc_ScalarRate, 16);
+        std::vector<float> out = renderPV(ugen, calc_BufRate, 16);
+        checkOutput(ugen.mName, out, reference, 1e-6);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: test_differential <plugin dir>\n");
+        return 2;
+    }
+    std::string error;
+    if (hostLoadPlugins(argv[1], error) == 0) {
+        fprintf(stderr, "test_differential: %s\n", error.c_str());
+        return 2;
+    }
+    RUN_TEST(testLoopPhasorRates);
+    RUN_TEST(testLoopPhasorControlRate);
+    RUN_TEST(testLoopPhasorLoop);
+    RUN_TEST(testLoopPhasorNegativeRate);
+    RUN_TEST(testLoopPhasorFinish);
+    RUN_TEST(testLoopPhasorStart);
+    RUN_TEST(testImpulseRates);
+    RUN_TEST(testImpulseModel);
+    RUN_TEST(testPVRates);
+    return checkExit();
+}
@@ -0,0 +1,313 @@
+/*
+File: test_ringbuffer.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the tests of RingBuffer and SpscRingBuffer: refused overruns and underruns,
+transfers that wrap around the end of the ring memory, in-place spans, index overflow, and a
+producer and consumer on separate threads.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "check.hpp"
+#include "ringbuffer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Reaches into the ring buffers, which befriend this class
+template <typename T>
+class TestRingBuffer {
+public:
+    static void setIndices(SpscRingBuffer<T>& ring, size_t index) {
+        ring.m_writeIndex.store(index);
+        ring.m_readIndex.store(index);
+    }
+    static size_t writeIndex(const SpscRingBuffer<T>& ring) {
+        return ring.m_writeIndex.load();
+    }
+    static size_t newSamples(const RingBuffer<T>& ring) {
+        return ring.m_newSamples;
+    }
+};
+
+// Fills n values counting up from first
+static std::vector<float> ramp(size_t n, float first) {
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; i++) {
+        values[i] = first + static_cast<float>(i);
+    }
+    return values;
+}
+
+static void testCapacity() {
+    SpscRingBuffer<float> ring(1000, 2);
+    CHECK_EQ(ring.capacity(), 1024);
+    CHECK_EQ(ring.size(), 2048);
+    SpscRingBuffer<float> exact(512);
+    CHECK_EQ(exact.capacity(), 512);
+    CHECK_EQ(exact.size(), 512);
+}
+
+static void testUninitialized() {
+    SpscRingBuffer<float> ring(8);
+    std::vector<float> values = ramp(4, 0.f);
+    CHECK(ring.write(values.data(), 4) == RingResult::Overrun);
+    CHECK(ring.read(values.data(), 4) == RingResult::Underrun);
+}
+
+static void testOverrun() {
+    SpscRingBuffer<float> ring(8);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    std::vector<float> values = ramp(9, 0.f);
+
+    // A write larger than the ring is refused whole
+    CHECK(ring.write(values.data(), 9) == RingResult::Overrun);
+    CHECK_EQ(ring.readAvailable(), 0);
+    CHECK_EQ(ring.writeAvailable(), 8);
+
+    // Filling the ring exactly is allowed, and one more element is not
+    CHECK(ring.write(values.data(), 6) == RingResult::Ok);
+    CHECK(ring.write(values.data() + 6, 3) == RingResult::Overrun);
+    CHECK(ring.write(values.data() + 6, 2) == RingResult::Ok);
+    CHECK_EQ(ring.writeAvailable(), 0);
+    CHECK(ring.write(values.data() + 8, 1) == RingResult::Overrun);
+
+    // The refused writes did not overwrite anything
+    std::vector<float> out(8, -1.f);
+    CHECK(ring.read(out.data(), 8) == RingResult::Ok);
+    for (size_t i = 0; i < 8; i++) {
+        CHECK_EQ(out[i], values[i]);
+    }
+}
+
+static void testUnderrun() {
+    SpscRingBuffer<float> ring(8);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    std::vector<float> out(8, -1.f);
+
+    CHECK(ring.read(out.data(), 1) == RingResult::Underrun);
+    CHECK(ring.skip(1) == RingResult::Underrun);
+
+    // A read larger than the unread data is refused whole and leaves the destination alone
+    std::vector<float> values = ramp(3, 10.f);
+    CHECK(ring.write(values.data(), 3) == RingResult::Ok);
+    CHECK(ring.read(out.data(), 4) == RingResult::Underrun);
+    CHECK_EQ(ring.readAvailable(), 3);
+    for (size_t i = 0; i < 8; i++) {
+        CHECK_EQ(out[i], -1.f);
+    }
+    CHECK(ring.skip(1) == RingResult::Ok);
+    CHECK(ring.read(out.data(), 2) == RingResult::Ok);
+    CHECK_EQ(out[0], 11.f);
+    CHECK_EQ(out[1], 12.f);
+    CHECK_EQ(ring.readAvailable(), 0);
+}
+
+static void testWrapAround() {
+    SpscRingBuffer<float> ring(8);
+    std::vector<float> memory(ring.size(), 0.f);
+    ring.initialize(memory.data());
+    std::vector<float> first = ramp(6, 0.f);
+    std::vector<float> out(8);
+    CHECK(ring.write(first.data(), 6) == RingResult::Ok);
+    CHECK(ring.read(out.data(), 6) == RingResult::Ok);
+
+    // The next write starts 2 elements before the end, so it is copied in two segments
+    RingSpan<float> span = ring.peekWrite(5);
+    CHECK(span.data[0] == memory.data() + 6);
+    CHECK_EQ(span.length[0], 2);
+    CHECK(span.data[1] == memory.data());
+    CHECK_EQ(span.length[1], 3);
+
+    std::vector<float> second = ramp(5, 100.f);
+    CHECK(ring.write(second.data(), 5) == RingResult::Ok);
+    CHECK_EQ(memory[6], 100.f);
+    CHECK_EQ(memory[7], 101.f);
+    CHECK_EQ(memory[0], 102.f);
+    CHECK_EQ(memory[2], 104.f);
+
+    // The read wraps the same way
+    RingSpan<const float> readSpan = ring.peekRead(5);
+    CHECK_EQ(readSpan.length[0], 2);
+    CHECK_EQ(readSpan.length[1], 3);
+    CHECK(ring.read(out.data(), 5) == RingResult::Ok);
+    for (size_t i = 0; i < 5; i++) {
+        CHECK_EQ(out[i], second[i]);
+    }
+
+    // A transfer that ends exactly at the end of the memory has an empty second segment
+    CHECK(ring.write(first.data(), 5) == RingResult::Ok);
+    RingSpan<const float> exact = ring.peekRead(5);
+    CHECK_EQ(exact.length[0], 5);
+    CHECK_EQ(exact.length[1], 0);
+}
+
+static void testSpans() {
+    SpscRingBuffer<float> ring(8, 2);
+    std::vector<float> memory(ring.size(), 0.f);
+    ring.initialize(memory.data());
+    ring.commitWrite(6);
+    ring.commitRead(6);
+
+    // Write both channels in place. Nothing is visible to the reader until the commit.
+    size_t length = 4;
+    CHECK(ring.writeAvailable() >= length);
+    for (size_t ch = 0; ch < 2; ch++) {
+        RingSpan<float> span = ring.peekWrite(length, ch);
+        CHECK_EQ(span.size(), length);
+        CHECK(span.data[0] == memory.data() + ch * ring.capacity() + 6);
+        size_t n = 0;
+        for (int s = 0; s < 2; s++) {
+            for (size_t i = 0; i < span.length[s]; i++, n++) {
+                span.data[s][i] = static_cast<float>(ch * 100 + n);
+            }
+        }
+        CHECK_EQ(ring.readAvailable(), 0);
+    }
+    ring.commitWrite(length);
+    CHECK_EQ(ring.readAvailable(), length);
+
+    // Read in place, then copy out with an offset to check the planar channels
+    for (size_t ch = 0; ch < 2; ch++) {
+        RingSpan<const float> span = ring.peekRead(length, ch);
+        CHECK_EQ(span.length[0], 2);
+        CHECK_EQ(span.data[0][0], ch * 100.f);
+        CHECK_EQ(span.data[1][1], ch * 100.f + 3.f);
+    }
+    CHECK_EQ(ring.readAvailable(), length);
+    std::vector<float> left(6, -1.f);
+    std::vector<float> right(6, -1.f);
+    float* destination[2] = {left.data(), right.data()};
+    CHECK(ring.readFrames(destination, length, 2) == RingResult::Ok);
+    CHECK_EQ(left[1], -1.f);
+    for (size_t i = 0; i < length; i++) {
+        CHECK_EQ(left[i + 2], static_cast<float>(i));
+        CHECK_EQ(right[i + 2], 100.f + i);
+    }
+    CHECK_EQ(ring.readAvailable(), 0);
+    CHECK_EQ(ring.writeAvailable(), 8);
+}
+
+static void testIndexOverflow() {
+    // The indices count every frame ever written, so they must survive wrapping past SIZE_MAX
+    SpscRingBuffer<float> ring(8);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    TestRingBuffer<float>::setIndices(ring, SIZE_MAX - 2);
+    std::vector<float> values = ramp(6, 1.f);
+    std::vector<float> out(6);
+    CHECK(ring.write(values.data(), 6) == RingResult::Ok);
+    CHECK(TestRingBuffer<float>::writeIndex(ring) < 8);
+    CHECK_EQ(ring.readAvailable(), 6);
+    CHECK_EQ(ring.writeAvailable(), 2);
+    CHECK(ring.read(out.data(), 6) == RingResult::Ok);
+    for (size_t i = 0; i < 6; i++) {
+        CHECK_EQ(out[i], values[i]);
+    }
+}
+
+static void testThreaded() {
+    // A producer and a consumer pass a running count through a small ring in mismatched block
+    // sizes. Every frame must arrive once, in order, on both channels.
+    const size_t total = 2000000;
+    SpscRingBuffer<float> ring(1024, 2);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+
+    std::thread producer([&]() {
+        std::vector<float> left(200);
+        std::vector<float> right(200);
+        const float* source[2] = {left.data(), right.data()};
+        size_t sent = 0;
+        size_t block = 1;
+        while (sent < total) {
+            size_t length = std::min(block, total - sent);
+            for (size_t i = 0; i < length; i++) {
+                left[i] = static_cast<float>((sent + i) % 16777216);
+                right[i] = -left[i];
+            }
+            if (ring.writeFrames(source, length) == RingResult::Ok) {
+                sent += length;
+                block = block % 199 + 1;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<float> left(256);
+    std::vector<float> right(256);
+    float* destination[2] = {left.data(), right.data()};
+    size_t received = 0;
+    size_t block = 256;
+    size_t numErrors = 0;
+    while (received < total) {
+        size_t length = std::min(block, total - received);
+        if (ring.readFrames(destination, length) == RingResult::Ok) {
+            for (size_t i = 0; i < length; i++) {
+                float expected = static_cast<float>((received + i) % 16777216);
+                if (left[i] != expected || right[i] != -expected) {
+                    numErrors++;
+                }
+            }
+            received += length;
+            block = block % 255 + 2;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK_EQ(numErrors, 0);
+    CHECK_EQ(ring.readAvailable(), 0);
+}
+
+static void testRingBuffer() {
+    // The original ring buffer reports a block once enough new samples have arrived
+    RingBuffer<float> ring(3, 4, 2);
+    CHECK_EQ(ring.size(), 14);
+    std::vector<float> memory(ring.size());
+    ring.initialize(memory.data());
+    std::vector<float> values = ramp(6, 0.f);
+    std::vector<float> out(4);
+    ring.writeBlock(values.data(), 3);
+    CHECK(!ring.isReadReady());
+    ring.writeBlock(values.data() + 3, 3);
+    CHECK(ring.isReadReady());
+    ring.readBlock(out.data());
+    CHECK_EQ(out[0], 0.f);
+    CHECK_EQ(out[3], 3.f);
+    CHECK_EQ(TestRingBuffer<float>::newSamples(ring), 2);
+    CHECK(!ring.isReadReady());
+}
+
+int main() {
+    RUN_TEST(testCapacity);
+    RUN_TEST(testUninitialized);
+    RUN_TEST(testOverrun);
+    RUN_TEST(testUnderrun);
+    RUN_TEST(testWrapAround);
+    RUN_TEST(testSpans);
+    RUN_TEST(testIndexOverflow);
+    RUN_TEST(testThreaded);
+    RUN_TEST(testRingBuffer);
+    return checkExit();
+}
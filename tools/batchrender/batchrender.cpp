@@ -0,0 +1,409 @@
+/*
+File: batchrender.cpp
+Author: Jeff Martin
+
+Description:
+This file contains batchrender, a command-line tool that runs a chain of UGens from the plugins
+over WAV files without a server. Consecutive PV units form a spectral stage that the tool wraps in
+an STFT, and every other unit processes the audio directly. Files are spread over a pool of
+worker threads, each with its own host, and streamed a chunk at a time, so memory use does not
+depend on file length.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "host.hpp"
+#include "stft.hpp"
+#include "wavfile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// The number of control periods read from a file at a time
+#define BATCH_CHUNK_BLOCKS 64
+
+// A UGen in the chain, with the values of its inputs other than the audio or FFT buffer
+struct UnitSpec {
+    std::string mName;
+    std::vector<float> mArgs;
+};
+
+struct Options {
+    std::string mPluginDir;
+    std::string mOutputDir;
+    std::vector<UnitSpec> mChain;
+    std::vector<std::string> mInputs;
+    int mNumThreads = 0;
+    int mBlockSize = 64;
+    int mFftSize = 2048;
+    float mHop = 0.5f;
+    double mTail = 0.0;
+    uint32 mSeed = 0;
+};
+
+// Outputs that some UGens have after their audio outputs
+static int extraOutputs(const std::string& name) {
+    if (name == "RubberBandPS") {
+        return 3;  // latency, underruns and quality tier
+    }
+    return 0;
+}
+
+static bool isSpectral(const std::string& name) {
+    return name.compare(0, 3, "PV_") == 0;
+}
+
+// Processes one control period of every channel in place
+struct Stage {
+    virtual ~Stage() {}
+    virtual void process(const std::vector<float*>& channels, int numSamples) = 0;
+};
+
+// A UGen that takes the channels as its last inputs and replaces them with its first outputs
+struct UnitStage : Stage {
+    std::unique_ptr<HostUnit> mUnit;
+    int mNumChannels;
+
+    void process(const std::vector<float*>& channels, int numSamples) override {
+        for (int c = 0; c < mNumChannels; c++) {
+            std::copy(channels[c], channels[c] + numSamples, mUnit->input(static_cast<int>(mUnit->mInBuf.size()) - mNumChannels + c));
+        }
+        mUnit->run();
+        for (int c = 0; c < mNumChannels; c++) {
+            std::copy(mUnit->output(c), mUnit->output(c) + numSamples, channels[c]);
+        }
+    }
+};
+
+// A chain of PV units that runs on every STFT frame of each channel
+struct SpectralStage : Stage {
+    struct Channel {
+        Stft mStft;
+        int mBufNum;
+        std::vector<std::unique_ptr<HostUnit>> mUnits;
+    };
+    Host* mHost;
+    std::vector<Channel> mChannels;
+    std::vector<float> mOutput;
+
+    void process(const std::vector<float*>& channels, int numSamples) override {
+        mOutput.resize(numSamples);
+        for (size_t c = 0; c < mChannels.size(); c++) {
+            Channel& channel = mChannels[c];
+            channel.mStft.process(channels[c], mOutput.data(), numSamples, [&](float* frame) { runFrame(channel, frame); });
+            std::copy(mOutput.begin(), mOutput.end(), channels[c]);
+        }
+    }
+
+    void runFrame(Channel& channel, float* frame) {
+        SndBuf* buf = &mHost->mBufs[channel.mBufNum];
+        std::copy(frame, frame + buf->samples, buf->data);
+        buf->coord = coord_Complex;
+        for (auto& unit : channel.mUnits) {
+            unit->input(0)[0] = static_cast<float>(channel.mBufNum);
+            unit->run();
+        }
+        if (buf->coord == coord_Polar) {
+            SCPolarBuf* polar = reinterpret_cast<SCPolarBuf*>(buf->data);
+            int numbins = (buf->samples - 2) >> 1;
+            for (int i = 0; i < numbins; i++) {
+                float mag = polar->bin[i].mag;
+                float phase = polar->bin[i].phase;
+                frame[2 * i + 2] = mag * std::cos(phase);
+                frame[2 * i + 3] = mag * std::sin(phase);
+            }
+            frame[0] = polar->dc;
+            frame[1] = polar->nyq;
+        } else {
+            std::copy(buf->data, buf->data + buf->samples, frame);
+        }
+    }
+};
+
+// Builds the stages of the chain for a file. On failure, error says why.
+static bool buildStages(const Options& options, Host& host, int numChannels, std::vector<std::unique_ptr<Stage>>& stages,
+    std::string& error) {
+    int hop = static_cast<int>(options.mFftSize * options.mHop);
+    int nextBufNum = 0;
+    size_t i = 0;
+    while (i < options.mChain.size()) {
+        if (isSpectral(options.mChain[i].mName)) {
+            std::unique_ptr<SpectralStage> stage(new SpectralStage);
+            stage->mHost = &host;
+            stage->mChannels.resize(numChannels);
+            size_t end = i;
+            while (end < options.mChain.size() && isSpectral(options.mChain[end].mName)) {
+                end++;
+            }
+            for (SpectralStage::Channel& channel : stage->mChannels) {
+                channel.mStft.init(options.mFftSize, hop);
+                channel.mBufNum = nextBufNum++;
+                if (hostBufAlloc(&host.mBufs[channel.mBufNum], 1, options.mFftSize, host.mWorld.mSampleRate) != 0) {
+                    error = "out of memory";
+                    return false;
+                }
+                for (size_t j = i; j < end; j++) {
+                    const UnitSpec& spec = options.mChain[j];
+                    std::unique_ptr<HostUnit> unit = host.createUnit(spec.mName, calc_BufRate, spec.mArgs, 1, true, 1, error);
+                    if (!unit) {
+                        return false;
+                    }
+                    channel.mUnits.push_back(std::move(unit));
+                }
+            }
+            stages.push_back(std::move(stage));
+            i = end;
+        } else {
+            const UnitSpec& spec = options.mChain[i];
+            std::unique_ptr<UnitStage> stage(new UnitStage);
+            stage->mNumChannels = numChannels;
+            stage->mUnit = host.createUnit(spec.mName, calc_FullRate, spec.mArgs, numChannels, false,
+                numChannels + extraOutputs(spec.mName), error);
+            if (!stage->mUnit) {
+                return false;
+            }
+            stages.push_back(std::move(stage));
+            i++;
+        }
+    }
+    return true;
+}
+
+static int countSpectralStages(const Options& options) {
+    int count = 0;
+    for (size_t i = 0; i < options.mChain.size(); i++) {
+        if (isSpectral(options.mChain[i].mName) && (i == 0 || !isSpectral(options.mChain[i - 1].mName))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Renders one file and sets seconds to the length of the output. On failure, error says why.
+static bool renderFile(const Options& options, const std::string& inPath, const std::string& outPath, int index,
+    double& seconds, std::string& error) {
+    WavReader reader;
+    if (!reader.open(inPath, error)) {
+        return false;
+    }
+    int numChannels = reader.mNumChannels;
+    int blockSize = options.mBlockSize;
+    Host host(reader.mSampleRate, blockSize, numChannels * countSpectralStages(options), index + 1000, options.mSeed + index);
+    std::vector<std::unique_ptr<Stage>> stages;
+    if (!buildStages(options, host, numChannels, stages, error)) {
+        return false;
+    }
+    WavWriter writer;
+    if (!writer.open(outPath, numChannels, reader.mSampleRate)) {
+        error = "cannot create " + outPath;
+        return false;
+    }
+
+    const int chunkFrames = blockSize * BATCH_CHUNK_BLOCKS;
+    std::vector<float> interleaved(static_cast<size_t>(chunkFrames) * numChannels);
+    std::vector<std::vector<float>> channelData(numChannels, std::vector<float>(chunkFrames));
+    std::vector<float*> block(numChannels);
+    int64_t tailLeft = static_cast<int64_t>(options.mTail * reader.mSampleRate);
+    for (;;) {
+        int numRead = reader.read(interleaved.data(), chunkFrames);
+        int numFrames = numRead;
+        if (numRead < chunkFrames) {
+            // Run the chain on silence after the end of the file to flush it
+            int numTail = static_cast<int>(std::min<int64_t>(chunkFrames - numRead, tailLeft));
+            std::fill(interleaved.begin() + static_cast<size_t>(numRead) * numChannels, interleaved.end(), 0.f);
+            numFrames += numTail;
+            tailLeft -= numTail;
+        }
+        if (numFrames == 0) {
+            break;
+        }
+        for (int c = 0; c < numChannels; c++) {
+            for (int i = 0; i < chunkFrames; i++) {
+                channelData[c][i] = interleaved[static_cast<size_t>(i) * numChannels + c];
+            }
+        }
+        // The last block may be partial, but units always run on whole control periods
+        for (int start = 0; start < numFrames; start += blockSize) {
+            for (int c = 0; c < numChannels; c++) {
+                block[c] = channelData[c].data() + start;
+            }
+            for (auto& stage : stages) {
+                stage->process(block, blockSize);
+            }
+        }
+        for (int c = 0; c < numChannels; c++) {
+            for (int i = 0; i < numFrames; i++) {
+                interleaved[static_cast<size_t>(i) * numChannels + c] = channelData[c][i];
+            }
+        }
+        if (!writer.write(interleaved.data(), numFrames)) {
+            error = "cannot write " + outPath;
+            return false;
+        }
+        if (numFrames < chunkFrames) {
+            break;
+        }
+    }
+    if (!writer.close()) {
+        error = "cannot write " + outPath;
+        return false;
+    }
+    seconds = static_cast<double>(writer.mNumFrames) / reader.mSampleRate;
+    return true;
+}
+
+static bool parseUnitSpec(const std::string& text, UnitSpec& spec) {
+    size_t colon = text.find(':');
+    spec.mName = text.substr(0, colon);
+    spec.mArgs.clear();
+    if (spec.mName.empty()) {
+        return false;
+    }
+    if (colon == std::string::npos) {
+        return true;
+    }
+    const char* pos = text.c_str() + colon + 1;
+    while (*pos) {
+        char* end;
+        spec.mArgs.push_back(strtof(pos, &end));
+        if (end == pos || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        pos = *end ? end + 1 : end;
+    }
+    return true;
+}
+
+static void printUsage() {
+    fprintf(stderr,
+        "usage: batchrender -p <plugin dir> -o <output dir> -u <ugen>[:<arg>,...] [-u ...] [options] <file.wav>...\n"
+        "\n"
+        "Runs the chain of UGens given with -u, in order, over each file. The arguments of a UGen are the\n"
+        "values of its inputs after its FFT buffer or before its audio inputs, as in its SynthDef. Consecutive\n"
+        "PV units share an STFT. Other UGens take the file's channels as their last inputs.\n"
+        "\n"
+        "  -j <n>         worker threads (default: one per core)\n"
+        "  -b <n>         control period in samples (default 64)\n"
+        "  --fft <n>      FFT size, a power of two (default 2048)\n"
+        "  --hop <f>      hop size as a fraction of the FFT size (default 0.5)\n"
+        "  --tail <sec>   seconds of silence to run after each file, to flush latency (default 0)\n"
+        "  --seed <n>     seed for the random generators; file i uses seed + i (default 0)\n"
+        "\n"
+        "example: batchrender -p build -o out -u PV_CFreeze:0,8 -u RubberBandPS:1.5,1,0,0 --tail 0.2 in/*.wav\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-p" && hasValue) {
+            options.mPluginDir = argv[++i];
+        } else if (arg == "-o" && hasValue) {
+            options.mOutputDir = argv[++i];
+        } else if (arg == "-u" && hasValue) {
+            UnitSpec spec;
+            if (!parseUnitSpec(argv[++i], spec)) {
+                fprintf(stderr, "batchrender: cannot parse the UGen %s\n", argv[i]);
+                return false;
+            }
+            options.mChain.push_back(spec);
+        } else if (arg == "-j" && hasValue) {
+            options.mNumThreads = atoi(argv[++i]);
+        } else if (arg == "-b" && hasValue) {
+            options.mBlockSize = atoi(argv[++i]);
+        } else if (arg == "--fft" && hasValue) {
+            options.mFftSize = atoi(argv[++i]);
+        } else if (arg == "--hop" && hasValue) {
+            options.mHop = static_cast<float>(atof(argv[++i]));
+        } else if (arg == "--tail" && hasValue) {
+            options.mTail = atof(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.mSeed = static_cast<uint32>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            fprintf(stderr, "batchrender: unknown option %s\n", arg.c_str());
+            return false;
+        } else {
+            options.mInputs.push_back(arg);
+        }
+    }
+    if (options.mPluginDir.empty() || options.mOutputDir.empty() || options.mChain.empty() || options.mInputs.empty()) {
+        return false;
+    }
+    int hop = static_cast<int>(options.mFftSize * options.mHop);
+    if (options.mBlockSize < 1 || options.mFftSize < 8 || (options.mFftSize & (options.mFftSize - 1)) != 0
+        || hop < 1 || options.mFftSize % hop != 0) {
+        fprintf(stderr, "batchrender: the FFT size must be a power of two, and the hop must divide it\n");
+        return false;
+    }
+    if (options.mNumThreads < 1) {
+        options.mNumThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return true;
+}
+
+static std::string outputPath(const Options& options, const std::string& inPath) {
+    size_t slash = inPath.find_last_of('/');
+    return options.mOutputDir + "/" + (slash == std::string::npos ? inPath : inPath.substr(slash + 1));
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    std::string error;
+    if (hostLoadPlugins(options.mPluginDir, error) == 0) {
+        fprintf(stderr, "batchrender: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::atomic<size_t> nextFile{0};
+    std::atomic<int> numFailed{0};
+    double rendered = 0.0;
+    std::mutex renderedMutex;
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&]() {
+        for (size_t i = nextFile++; i < options.mInputs.size(); i = nextFile++) {
+            const std::string& inPath = options.mInputs[i];
+            std::string outPath = outputPath(options, inPath);
+            std::string fileError = "the output would overwrite the input";
+            double seconds;
+            if (outPath == inPath || !renderFile(options, inPath, outPath, static_cast<int>(i), seconds, fileError)) {
+                hostPrint("batchrender: %s: %s\n", inPath.c_str(), fileError.c_str());
+                numFailed++;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(renderedMutex);
+            rendered += seconds;
+        }
+    };
+    std::vector<std::thread> threads;
+    int numThreads = std::min<int>(options.mNumThreads, static_cast<int>(options.mInputs.size()));
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    hostPrint("batchrender: rendered %zu files (%.1f s of audio) in %.1f s on %d threads, %.1fx real time; %d failed\n",
+        options.mInputs.size() - numFailed, rendered, elapsed, numThreads, elapsed > 0.0 ? rendered / elapsed : 0.0,
+        numFailed.load());
+    return numFailed > 0 ? 1 : 0;
+}
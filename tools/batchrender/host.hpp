@@ -0,0 +1,518 @@
+/*
+File: host.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the stand-in host for the batch renderer. It loads plugin libraries through
+their PluginLoad entry point with its own InterfaceTable, and builds units outside a server: each
+unit gets a World, a Graph, wires and buffers of its own. The host is offline, so asynchronous commands run all of their stages at once, and messages between
+the threads are performed immediately. Units that need buffers other than their FFT buffer, or
+buses, are not supported.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "SC_PlugIn.h"
+#include "FFT_UGens.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A unit type defined by a plugin
+struct HostUnitDef {
+    size_t mSize;
+    UnitCtorFunc mCtor;
+    UnitDtorFunc mDtor;
+};
+
+// The unit types of every loaded plugin. They are defined while the plugins load, before any worker
+// starts, and only read afterwards.
+static std::map<std::string, HostUnitDef> gHostUnitDefs;
+static std::mutex gHostPrintMutex;
+
+static int hostPrint(const char* format, ...) {
+    std::lock_guard<std::mutex> lock(gHostPrintMutex);
+    va_list args;
+    va_start(args, format);
+    int result = vfprintf(stderr, format, args);
+    va_end(args);
+    return result;
+}
+
+static int32 hostRanSeed() {
+    static std::mutex mutex;
+    static std::random_device device;
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int32>(device());
+}
+
+static bool hostDefineUnit(const char* name, size_t size, UnitCtorFunc ctor, UnitDtorFunc dtor, uint32 flags) {
+    gHostUnitDefs[name] = HostUnitDef{size, ctor, dtor};
+    return true;
+}
+
+// Plugin commands, unit commands and buffer fill commands are accepted, but the host never runs them
+static bool hostDefinePlugInCmd(const char* name, PlugInCmdFunc func, void* userData) {
+    return true;
+}
+
+static bool hostDefineUnitCmd(const char* unitName, const char* name, UnitCmdFunc func) {
+    return true;
+}
+
+static bool hostDefineBufGen(const char* name, BufGenFunc func) {
+    return true;
+}
+
+static void hostClearUnitOutputs(Unit* unit, int numSamples) {
+    for (uint32 i = 0; i < unit->mNumOutputs; i++) {
+        memset(unit->mOutBuf[i], 0, numSamples * sizeof(float));
+    }
+}
+
+static void* hostNRTAlloc(size_t size) {
+    return malloc(size);
+}
+
+static void* hostNRTRealloc(void* ptr, size_t size) {
+    return realloc(ptr, size);
+}
+
+static void hostNRTFree(void* ptr) {
+    free(ptr);
+}
+
+// The RT pool is allocated once, when the first plugin loads, as the server's is, so that RT
+// allocation never reaches malloc and the real-time safety checker only reports the plugins' own
+// calls. Blocks are a power of two in size, header included, and freed blocks go on a free list
+// for their size. Every worker shares the pool, under a spin lock rather than a mutex, which the
+// checker would also report. Like the server's pool, it returns null when it runs out.
+#define HOST_RT_POOL_SIZE (64 << 20)
+#define HOST_RT_HEADER_SIZE 16
+#define HOST_RT_MIN_CLASS 5
+#define HOST_RT_NUM_CLASSES 32
+
+struct HostRtBlock {
+    int mClass;
+    HostRtBlock* mNext;  // the next free block of the same size, while the block is free
+};
+
+static_assert(sizeof(HostRtBlock) <= HOST_RT_HEADER_SIZE, "the header must fit in front of the memory");
+
+struct HostRtPool {
+    char* mMemory = nullptr;
+    size_t mUsed = 0;
+    HostRtBlock* mFree[HOST_RT_NUM_CLASSES] = {};
+    std::atomic_flag mLock = ATOMIC_FLAG_INIT;
+
+    void lock() {
+        while (mLock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        mLock.clear(std::memory_order_release);
+    }
+};
+
+static HostRtPool gHostRtPool;
+
+static void* hostRTAlloc(World* world, size_t size) {
+    int sizeClass = HOST_RT_MIN_CLASS;
+    while (sizeClass < HOST_RT_NUM_CLASSES && (size_t(1) << sizeClass) < size + HOST_RT_HEADER_SIZE) {
+        sizeClass++;
+    }
+    if (sizeClass == HOST_RT_NUM_CLASSES) {
+        return nullptr;
+    }
+    size_t blockSize = size_t(1) << sizeClass;
+    HostRtPool& pool = gHostRtPool;
+    pool.lock();
+    HostRtBlock* block = pool.mFree[sizeClass];
+    if (block) {
+        pool.mFree[sizeClass] = block->mNext;
+    } else if (pool.mMemory && pool.mUsed + blockSize <= HOST_RT_POOL_SIZE) {
+        block = reinterpret_cast<HostRtBlock*>(pool.mMemory + pool.mUsed);
+        block->mClass = sizeClass;
+        pool.mUsed += blockSize;
+    }
+    pool.unlock();
+    return block ? reinterpret_cast<char*>(block) + HOST_RT_HEADER_SIZE : nullptr;
+}
+
+static void hostRTFree(World* world, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    HostRtBlock* block = reinterpret_cast<HostRtBlock*>(static_cast<char*>(ptr) - HOST_RT_HEADER_SIZE);
+    HostRtPool& pool = gHostRtPool;
+    pool.lock();
+    block->mNext = pool.mFree[block->mClass];
+    pool.mFree[block->mClass] = block;
+    pool.unlock();
+}
+
+static void* hostRTRealloc(World* world, void* ptr, size_t size) {
+    if (!ptr) {
+        return hostRTAlloc(world, size);
+    }
+    HostRtBlock* block = reinterpret_cast<HostRtBlock*>(static_cast<char*>(ptr) - HOST_RT_HEADER_SIZE);
+    size_t capacity = (size_t(1) << block->mClass) - HOST_RT_HEADER_SIZE;
+    if (size <= capacity) {
+        return ptr;
+    }
+    void* grown = hostRTAlloc(world, size);
+    if (grown) {
+        memcpy(grown, ptr, capacity);
+        hostRTFree(world, ptr);
+    }
+    return grown;
+}
+
+// Performs a message at once. The server has a single NRT thread, so messages from different workers
+// are still performed one at a time.
+static bool hostSendMsg(World* world, FifoMsg& msg) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (msg.mPerformFunc) {
+        msg.mPerformFunc(&msg);
+    }
+    if (msg.mFreeFunc) {
+        msg.mFreeFunc(&msg);
+    }
+    return true;
+}
+
+static int hostDoAsynchronousCommand(World* world, void* replyAddr, const char* cmdName, void* cmdData,
+    AsyncStageFn stage2, AsyncStageFn stage3, AsyncStageFn stage4, AsyncFreeFn cleanup,
+    int completionMsgSize, void* completionMsgData) {
+    // Each stage runs only if the one before it succeeded, as in the server
+    if ((!stage2 || stage2(world, cmdData)) && (!stage3 || stage3(world, cmdData)) && stage4) {
+        stage4(world, cmdData);
+    }
+    if (cleanup) {
+        cleanup(world, cmdData);
+    }
+    return 0;
+}
+
+static int hostBufAlloc(SndBuf* buf, int numChannels, int numFrames, double sampleRate) {
+    float* data = static_cast<float*>(calloc(static_cast<size_t>(numChannels) * numFrames, sizeof(float)));
+    if (!data) {
+        return -1;
+    }
+    buf->data = data;
+    buf->channels = numChannels;
+    buf->frames = numFrames;
+    buf->samples = numChannels * numFrames;
+    buf->samplerate = sampleRate;
+    buf->sampledur = 1.0 / sampleRate;
+    buf->mask = buf->mask1 = 0;
+    return 0;
+}
+
+static bool hostIsNonRealTime(World* world) {
+    return true;
+}
+
+static InterfaceTable* hostInterfaceTable() {
+    static InterfaceTable table;
+    static bool initialized = false;
+    if (!initialized) {
+        gHostRtPool.mMemory = static_cast<char*>(malloc(HOST_RT_POOL_SIZE));
+        memset(&table, 0, sizeof(table));
+        table.fPrint = hostPrint;
+        table.fRanSeed = hostRanSeed;
+        table.fDefineUnit = hostDefineUnit;
+        table.fDefinePlugInCmd = hostDefinePlugInCmd;
+        table.fDefineUnitCmd = hostDefineUnitCmd;
+        table.fDefineBufGen = hostDefineBufGen;
+        table.fClearUnitOutputs = hostClearUnitOutputs;
+        table.fNRTAlloc = hostNRTAlloc;
+        table.fNRTRealloc = hostNRTRealloc;
+        table.fNRTFree = hostNRTFree;
+        table.fRTAlloc = hostRTAlloc;
+        table.fRTRealloc = hostRTRealloc;
+        table.fRTFree = hostRTFree;
+        table.fSendMsgFromRT = hostSendMsg;
+        table.fSendMsgToRT = hostSendMsg;
+        table.fDoAsynchronousCommand = hostDoAsynchronousCommand;
+        table.fBufAlloc = hostBufAlloc;
+        table.fIsNonRealTime = hostIsNonRealTime;
+        initialized = true;
+    }
+    return &table;
+}
+
+typedef void (*PluginLoadFunc)(InterfaceTable*);
+
+// Loads every plugin library in a directory. Supernova builds are skipped, since the host is not
+// supernova. Returns the number of libraries loaded.
+static int hostLoadPlugins(const std::string& directory, std::string& error) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        error = "cannot open the plugin directory " + directory;
+        return 0;
+    }
+    int numLoaded = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        bool isPlugin = (name.size() > 3 && name.compare(name.size() - 3, 3, ".so") == 0)
+            || (name.size() > 4 && name.compare(name.size() - 4, 4, ".scx") == 0);
+        if (!isPlugin || name.find("_supernova") != std::string::npos) {
+            continue;
+        }
+        std::string path = directory + "/" + name;
+        void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library) {
+            hostPrint("batchrender: skipping %s: %s\n", path.c_str(), dlerror());
+            continue;
+        }
+        PluginLoadFunc load = (PluginLoadFunc)dlsym(library, "load");
+        if (!load) {
+            dlclose(library);
+            continue;
+        }
+        load(hostInterfaceTable());
+        numLoaded++;
+    }
+    closedir(dir);
+    if (numLoaded == 0) {
+        error = "no plugins found in " + directory;
+    }
+    return numLoaded;
+}
+
+// An input of a unit. A scalar input is constant. A control-rate input has one sample per block and
+// an audio-rate input a whole block. Signal inputs hold mValue until the caller writes new values.
+struct HostInput {
+    int mCalcRate;
+    float mValue;
+};
+
+// One unit with its own wires. The caller writes the signal inputs into the input buffers before
+// each call to run().
+struct HostUnit {
+    std::string mName;
+    Unit* mUnit = nullptr;
+    UnitDtorFunc mDtor = nullptr;
+    std::vector<Wire> mInputWires;
+    std::vector<Wire> mOutputWires;
+    std::vector<Wire*> mInputs;
+    std::vector<Wire*> mOutputs;
+    std::vector<float*> mInBuf;
+    std::vector<float*> mOutBuf;
+    std::vector<float> mSignals;  // the input signals in order, then the outputs
+
+    ~HostUnit() {
+        if (mUnit) {
+            if (mDtor) {
+                mDtor(mUnit);
+            }
+            free(mUnit);
+        }
+    }
+
+    void run() {
+        mUnit->mCalcFunc(mUnit, mUnit->mBufLength);
+    }
+
+    float* input(int index) {
+        return mInBuf[index];
+    }
+
+    float* output(int index) {
+        return mOutBuf[index];
+    }
+};
+
+// The world, graph and buffers that a set of units share. Every worker thread has its own.
+struct Host {
+    World mWorld;
+    Graph mGraph;
+    RGen mRGen;
+    Unit mSources[3];  // the units that the wires of each rate come from
+    std::vector<SndBuf> mBufs;
+
+    // The block size is the length of a control period, as in the server
+    Host(double sampleRate, int blockSize, int numBufs, int32 nodeID, uint32 seed) {
+        memset(&mWorld, 0, sizeof(mWorld));
+        memset(&mGraph, 0, sizeof(mGraph));
+        memset(mSources, 0, sizeof(mSources));
+        mWorld.ft = hostInterfaceTable();
+        mWorld.mSampleRate = sampleRate;
+        mWorld.mBufLength = blockSize;
+        initRate(mWorld.mFullRate, sampleRate, blockSize);
+        initRate(mWorld.mBufRate, sampleRate / blockSize, 1);
+        mRGen.init(seed);
+        mWorld.mNumRGens = 1;
+        mWorld.mRGen = &mRGen;
+        mBufs.resize(numBufs);
+        memset(mBufs.data(), 0, numBufs * sizeof(SndBuf));
+        mWorld.mNumSndBufs = numBufs;
+        mWorld.mSndBufs = mBufs.data();
+        mWorld.mSndBufsNonRealTimeMirror = mBufs.data();
+        mWorld.mRealTime = false;
+        mGraph.mNode.mID = nodeID;
+        mGraph.mRGen = &mRGen;
+        mSources[calc_ScalarRate].mBufLength = 1;
+        mSources[calc_BufRate].mBufLength = 1;
+        mSources[calc_FullRate].mBufLength = blockSize;
+    }
+
+    ~Host() {
+        for (SndBuf& buf : mBufs) {
+            free(buf.data);
+        }
+    }
+
+    static void initRate(Rate& rate, double sampleRate, int bufLength) {
+        memset(&rate, 0, sizeof(rate));
+        rate.mSampleRate = sampleRate;
+        rate.mSampleDur = 1.0 / sampleRate;
+        rate.mBufLength = bufLength;
+        rate.mBufDuration = bufLength / sampleRate;
+        rate.mBufRate = sampleRate / bufLength;
+        rate.mSlopeFactor = 1.0 / bufLength;
+        rate.mRadiansPerSample = 2.0 * M_PI / sampleRate;
+        rate.mFilterLoops = bufLength / 3;
+        rate.mFilterRemain = bufLength % 3;
+        rate.mFilterSlope = rate.mFilterLoops == 0 ? 0.0 : 1.0 / rate.mFilterLoops;
+    }
+
+    // Builds a unit at calc_FullRate or calc_BufRate. The inputs listed in scalars are constant and
+    // the rest, numSignals of them, run at the unit's rate. Signal inputs come after the scalars,
+    // unless signalsFirst is set. On failure, returns null and error says why.
+    std::unique_ptr<HostUnit> createUnit(const std::string& name, int calcRate, const std::vector<float>& scalars,
+        int numSignals, bool signalsFirst, int numOutputs, std::string& error) {
+        std::vector<HostInput> inputs;
+        int firstSignal = signalsFirst ? 0 : static_cast<int>(scalars.size());
+        int numInputs = static_cast<int>(scalars.size()) + numSignals;
+        int scalarIndex = 0;
+        for (int i = 0; i < numInputs; i++) {
+            if (i >= firstSignal && i < firstSignal + numSignals) {
+                inputs.push_back(HostInput{calcRate, 0.f});
+            } else {
+                inputs.push_back(HostInput{calc_ScalarRate, scalars[scalarIndex++]});
+            }
+        }
+        return createUnit(name, calcRate, inputs, numOutputs, error);
+    }
+
+    // Builds a unit at calc_FullRate or calc_BufRate with inputs at any rate. The signal inputs hold
+    // their values before the Ctor runs, as they would in a synth. On failure, returns null and error says why.
+    std::unique_ptr<HostUnit> createUnit(const std::string& name, int calcRate, const std::vector<HostInput>& inputs,
+        int numOutputs, std::string& error) {
+        auto found = gHostUnitDefs.find(name);
+        if (found == gHostUnitDefs.end()) {
+            error = "no plugin defines " + name;
+            return nullptr;
+        }
+        const HostUnitDef& def = found->second;
+        int bufLength = calcRate == calc_FullRate ? mWorld.mBufLength : 1;
+        int numInputs = static_cast<int>(inputs.size());
+
+        // Lay out the signal inputs, then the outputs, in one array
+        std::vector<size_t> offsets(numInputs, 0);
+        size_t numSignalSamples = 0;
+        for (int i = 0; i < numInputs; i++) {
+            offsets[i] = numSignalSamples;
+            if (inputs[i].mCalcRate == calc_FullRate) {
+                numSignalSamples += mWorld.mBufLength;
+            } else if (inputs[i].mCalcRate == calc_BufRate) {
+                numSignalSamples += 1;
+            }
+        }
+
+        std::unique_ptr<HostUnit> hostUnit(new HostUnit);
+        hostUnit->mName = name;
+        hostUnit->mSignals.assign(numSignalSamples + static_cast<size_t>(numOutputs) * bufLength, 0.f);
+        hostUnit->mInputWires.resize(numInputs);
+        hostUnit->mOutputWires.resize(numOutputs);
+        for (int i = 0; i < numInputs; i++) {
+            const HostInput& input = inputs[i];
+            Wire& wire = hostUnit->mInputWires[i];
+            memset(&wire, 0, sizeof(wire));
+            if (input.mCalcRate == calc_FullRate || input.mCalcRate == calc_BufRate) {
+                int length = input.mCalcRate == calc_FullRate ? mWorld.mBufLength : 1;
+                wire.mCalcRate = input.mCalcRate;
+                wire.mFromUnit = &mSources[input.mCalcRate];
+                wire.mBuffer = &hostUnit->mSignals[offsets[i]];
+                std::fill(wire.mBuffer, wire.mBuffer + length, input.mValue);
+            } else {
+                wire.mCalcRate = calc_ScalarRate;
+                wire.mFromUnit = &mSources[calc_ScalarRate];
+                wire.mScalarValue = input.mValue;
+                wire.mBuffer = &wire.mScalarValue;
+            }
+        }
+        for (int i = 0; i < numOutputs; i++) {
+            Wire& wire = hostUnit->mOutputWires[i];
+            memset(&wire, 0, sizeof(wire));
+            wire.mCalcRate = calcRate;
+            wire.mBuffer = &hostUnit->mSignals[numSignalSamples + static_cast<size_t>(i) * bufLength];
+        }
+        for (Wire& wire : hostUnit->mInputWires) {
+            hostUnit->mInputs.push_back(&wire);
+            hostUnit->mInBuf.push_back(wire.mBuffer);
+        }
+        for (Wire& wire : hostUnit->mOutputWires) {
+            hostUnit->mOutputs.push_back(&wire);
+            hostUnit->mOutBuf.push_back(wire.mBuffer);
+        }
+
+        Unit* unit = static_cast<Unit*>(calloc(1, def.mSize));
+        if (!unit) {
+            error = "out of memory";
+            return nullptr;
+        }
+        unit->mWorld = &mWorld;
+        unit->mParent = &mGraph;
+        unit->mNumInputs = numInputs;
+        unit->mNumOutputs = numOutputs;
+        unit->mCalcRate = static_cast<int16>(calcRate);
+        unit->mInput = hostUnit->mInputs.data();
+        unit->mOutput = hostUnit->mOutputs.data();
+        unit->mRate = calcRate == calc_FullRate ? &mWorld.mFullRate : &mWorld.mBufRate;
+        unit->mInBuf = hostUnit->mInBuf.data();
+        unit->mOutBuf = hostUnit->mOutBuf.data();
+        unit->mBufLength = bufLength;
+        hostUnit->mUnit = unit;
+        def.mCtor(unit);
+        hostUnit->mDtor = def.mDtor;
+        if (!unit->mCalcFunc) {
+            error = name + " did not set a calc function";
+            return nullptr;
+        }
+        return hostUnit;
+    }
+};
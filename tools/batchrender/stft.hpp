@@ -0,0 +1,158 @@
+/*
+File: stft.hpp
+Author: Jeff Martin
+
+Description:
+This file contains the short-time Fourier transform that the batch renderer wraps around PV
+chains, in place of the FFT and IFFT UGens. Frames are windowed with a sine window on analysis
+and on synthesis, like FFT and IFFT with their default window, and passed to the chain in the
+layout of an FFT buffer: DC, Nyquist, then the real and imaginary parts of each other bin.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <vector>
+
+// An in-place radix-2 FFT of a power-of-two size. The inverse is not scaled.
+struct Fft {
+    int mSize = 0;
+    std::vector<std::complex<float>> mTwiddles;
+    std::vector<int> mReversed;
+
+    void init(int size) {
+        mSize = size;
+        mTwiddles.resize(size / 2);
+        for (int i = 0; i < size / 2; i++) {
+            mTwiddles[i] = std::polar(1.f, static_cast<float>(-2.0 * M_PI * i / size));
+        }
+        int numBits = 0;
+        while ((1 << numBits) < size) {
+            numBits++;
+        }
+        mReversed.resize(size);
+        for (int i = 0; i < size; i++) {
+            int reversed = 0;
+            for (int bit = 0; bit < numBits; bit++) {
+                reversed |= ((i >> bit) & 1) << (numBits - 1 - bit);
+            }
+            mReversed[i] = reversed;
+        }
+    }
+
+    void transform(std::complex<float>* data, bool inverse) const {
+        for (int i = 0; i < mSize; i++) {
+            if (i < mReversed[i]) {
+                std::swap(data[i], data[mReversed[i]]);
+            }
+        }
+        for (int length = 2; length <= mSize; length <<= 1) {
+            int step = mSize / length;
+            for (int start = 0; start < mSize; start += length) {
+                for (int i = 0; i < length / 2; i++) {
+                    std::complex<float> twiddle = inverse ? std::conj(mTwiddles[i * step]) : mTwiddles[i * step];
+                    std::complex<float> odd = data[start + i + length / 2] * twiddle;
+                    data[start + i + length / 2] = data[start + i] - odd;
+                    data[start + i] += odd;
+                }
+            }
+        }
+    }
+};
+
+// Runs a callback on every analysis frame of a stream and overlap-adds the results. The output
+// is delayed by one frame size.
+struct Stft {
+    typedef std::function<void(float*)> FrameFunc;
+
+    int mSize = 0;
+    int mHop = 0;
+    int mPos = 0;       // position in mInput and mOutput of the next sample
+    int mHopCount = 0;  // samples since the last frame
+    float mGain = 0.f;  // makes the overlapping windows sum to one
+    Fft mFft;
+    std::vector<float> mWindow;
+    std::vector<float> mInput;     // the last mSize input samples, circular
+    std::vector<float> mOutput;    // overlap-added output, circular
+    std::vector<float> mFrame;     // one frame in the layout of an FFT buffer
+    std::vector<std::complex<float>> mSpectrum;
+
+    // size must be a power of two, and hop must divide it
+    void init(int size, int hop) {
+        mSize = size;
+        mHop = hop;
+        mPos = 0;
+        mHopCount = 0;
+        // Sine windows on analysis and synthesis multiply to a Hann window, whose overlaps sum
+        // to size / (2 * hop). The inverse FFT also needs scaling by 1 / size.
+        mGain = 2.f * hop / size / size;
+        mFft.init(size);
+        mWindow.resize(size);
+        for (int i = 0; i < size; i++) {
+            mWindow[i] = static_cast<float>(std::sin(M_PI * (i + 0.5) / size));
+        }
+        mInput.assign(size, 0.f);
+        mOutput.assign(size, 0.f);
+        mFrame.assign(size, 0.f);
+        mSpectrum.assign(size, 0.f);
+    }
+
+    void process(const float* in, float* out, int numSamples, const FrameFunc& frameFunc) {
+        for (int i = 0; i < numSamples; i++) {
+            out[i] = mOutput[mPos];
+            mOutput[mPos] = 0.f;
+            mInput[mPos] = in[i];
+            mPos = (mPos + 1) % mSize;
+            if (++mHopCount == mHop) {
+                mHopCount = 0;
+                runFrame(frameFunc);
+            }
+        }
+    }
+
+    // Analyzes the last mSize samples, which start at mPos, and adds the resynthesized frame to
+    // the next mSize output samples
+    void runFrame(const FrameFunc& frameFunc) {
+        for (int i = 0; i < mSize; i++) {
+            int index = (mPos + i) % mSize;
+            mSpectrum[i] = std::complex<float>(mInput[index] * mWindow[i], 0.f);
+        }
+        mFft.transform(mSpectrum.data(), false);
+        int half = mSize / 2;
+        mFrame[0] = mSpectrum[0].real();
+        mFrame[1] = mSpectrum[half].real();
+        for (int bin = 1; bin < half; bin++) {
+            mFrame[2 * bin] = mSpectrum[bin].real();
+            mFrame[2 * bin + 1] = mSpectrum[bin].imag();
+        }
+        frameFunc(mFrame.data());
+        mSpectrum[0] = mFrame[0];
+        mSpectrum[half] = mFrame[1];
+        for (int bin = 1; bin < half; bin++) {
+            mSpectrum[bin] = std::complex<float>(mFrame[2 * bin], mFrame[2 * bin + 1]);
+            mSpectrum[mSize - bin] = std::conj(mSpectrum[bin]);
+        }
+        mFft.transform(mSpectrum.data(), true);
+        for (int i = 0; i < mSize; i++) {
+            int index = (mPos + i) % mSize;
+            mOutput[index] += mSpectrum[i].real() * mWindow[i] * mGain;
+        }
+    }
+};
@@ -0,0 +1,244 @@
+/*
+File: wavfile.hpp
+Author: Jeff Martin
+
+Description:
+This file contains a streaming WAV reader and writer for the batch renderer. The reader accepts
+16-, 24- and 32-bit integer and 32-bit float files, including WAVE_FORMAT_EXTENSIBLE. The writer
+writes 32-bit float. Both work a chunk of frames at a time, so memory does not grow with the file.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// WAV files are little-endian
+static inline uint32_t wavGet32(const unsigned char* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static inline uint16_t wavGet16(const unsigned char* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+static inline void wavPut32(unsigned char* bytes, uint32_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = (value >> 24) & 0xFF;
+}
+
+static inline void wavPut16(unsigned char* bytes, uint16_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+}
+
+struct WavReader {
+    FILE* mFile = nullptr;
+    int mNumChannels = 0;
+    int mSampleRate = 0;
+    int mFormat = 0;          // WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+    int mBytesPerSample = 0;
+    int64_t mNumFrames = 0;
+    int64_t mFramesLeft = 0;
+    std::vector<unsigned char> mBytes;  // raw samples of one chunk
+
+    ~WavReader() {
+        close();
+    }
+
+    // Opens a file and reads its header. On failure, error says why.
+    bool open(const std::string& path, std::string& error) {
+        mFile = fopen(path.c_str(), "rb");
+        if (!mFile) {
+            error = "cannot open the file";
+            return false;
+        }
+        unsigned char header[12];
+        if (fread(header, 1, 12, mFile) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+            error = "not a WAV file";
+            return false;
+        }
+        bool haveFormat = false;
+        uint32_t dataSize = 0;
+        for (;;) {
+            unsigned char chunkHeader[8];
+            if (fread(chunkHeader, 1, 8, mFile) != 8) {
+                error = "the file has no data chunk";
+                return false;
+            }
+            uint32_t chunkSize = wavGet32(chunkHeader + 4);
+            if (memcmp(chunkHeader, "fmt ", 4) == 0) {
+                unsigned char format[40];
+                uint32_t formatSize = chunkSize < sizeof(format) ? chunkSize : sizeof(format);
+                if (formatSize < 16 || fread(format, 1, formatSize, mFile) != formatSize) {
+                    error = "the format chunk is truncated";
+                    return false;
+                }
+                mFormat = wavGet16(format);
+                mNumChannels = wavGet16(format + 2);
+                mSampleRate = static_cast<int>(wavGet32(format + 4));
+                mBytesPerSample = wavGet16(format + 14) / 8;
+                if (mFormat == WAV_FORMAT_EXTENSIBLE && formatSize >= 26) {
+                    // The format is the first two bytes of the subformat GUID
+                    mFormat = wavGet16(format + 24);
+                }
+                if (fseek(mFile, (chunkSize - formatSize) + (chunkSize & 1), SEEK_CUR) != 0) {
+                    error = "the format chunk is truncated";
+                    return false;
+                }
+                haveFormat = true;
+            } else if (memcmp(chunkHeader, "data", 4) == 0) {
+                if (!haveFormat) {
+                    error = "the data chunk comes before the format chunk";
+                    return false;
+                }
+                dataSize = chunkSize;
+                break;
+            } else if (fseek(mFile, chunkSize + (chunkSize & 1), SEEK_CUR) != 0) {
+                error = "a chunk is truncated";
+                return false;
+            }
+        }
+        bool supported = (mFormat == WAV_FORMAT_PCM && mBytesPerSample >= 2 && mBytesPerSample <= 4)
+            || (mFormat == WAV_FORMAT_FLOAT && mBytesPerSample == 4);
+        if (!supported || mNumChannels < 1 || mSampleRate < 1) {
+            error = "unsupported sample format (use 16-, 24- or 32-bit integer, or 32-bit float)";
+            return false;
+        }
+        // Some writers leave the data size at 0 or 0xFFFFFFFF when streaming, so the data is cut
+        // off at the end of the file
+        long dataStart = ftell(mFile);
+        fseek(mFile, 0, SEEK_END);
+        int64_t available = static_cast<int64_t>(ftell(mFile)) - dataStart;
+        fseek(mFile, dataStart, SEEK_SET);
+        if (dataSize != 0 && dataSize < available) {
+            available = dataSize;
+        }
+        mNumFrames = available / (mBytesPerSample * mNumChannels);
+        mFramesLeft = mNumFrames;
+        return true;
+    }
+
+    // Reads up to numFrames interleaved frames and returns the number read
+    int read(float* interleaved, int numFrames) {
+        if (numFrames > mFramesLeft) {
+            numFrames = static_cast<int>(mFramesLeft);
+        }
+        size_t numSamples = static_cast<size_t>(numFrames) * mNumChannels;
+        mBytes.resize(numSamples * mBytesPerSample);
+        size_t numRead = fread(mBytes.data(), mBytesPerSample, numSamples, mFile);
+        const unsigned char* bytes = mBytes.data();
+        for (size_t i = 0; i < numRead; i++, bytes += mBytesPerSample) {
+            if (mFormat == WAV_FORMAT_FLOAT) {
+                uint32_t bits = wavGet32(bytes);
+                memcpy(&interleaved[i], &bits, sizeof(float));
+            } else if (mBytesPerSample == 2) {
+                interleaved[i] = static_cast<int16_t>(wavGet16(bytes)) / 32768.f;
+            } else if (mBytesPerSample == 3) {
+                // Shift the sample to the top of a 32-bit word to extend the sign
+                int32_t value = static_cast<int32_t>((bytes[0] << 8) | (bytes[1] << 16) | (static_cast<uint32_t>(bytes[2]) << 24)) >> 8;
+                interleaved[i] = value / 8388608.f;
+            } else {
+                interleaved[i] = static_cast<int32_t>(wavGet32(bytes)) / 2147483648.f;
+            }
+        }
+        int framesRead = static_cast<int>(numRead / mNumChannels);
+        mFramesLeft = framesRead < numFrames ? 0 : mFramesLeft - framesRead;
+        return framesRead;
+    }
+
+    void close() {
+        if (mFile) {
+            fclose(mFile);
+            mFile = nullptr;
+        }
+    }
+};
+
+struct WavWriter {
+    FILE* mFile = nullptr;
+    int mNumChannels = 0;
+    int64_t mNumFrames = 0;
+    std::vector<unsigned char> mBytes;
+
+    ~WavWriter() {
+        close();
+    }
+
+    // Creates a 32-bit float file. The sizes in the header are filled in by close().
+    bool open(const std::string& path, int numChannels, int sampleRate) {
+        mFile = fopen(path.c_str(), "wb");
+        if (!mFile) {
+            return false;
+        }
+        mNumChannels = numChannels;
+        mNumFrames = 0;
+        unsigned char header[44];
+        memcpy(header, "RIFF", 4);
+        wavPut32(header + 4, 0);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        wavPut32(header + 16, 16);
+        wavPut16(header + 20, WAV_FORMAT_FLOAT);
+        wavPut16(header + 22, static_cast<uint16_t>(numChannels));
+        wavPut32(header + 24, static_cast<uint32_t>(sampleRate));
+        wavPut32(header + 28, static_cast<uint32_t>(sampleRate * numChannels * 4));
+        wavPut16(header + 32, static_cast<uint16_t>(numChannels * 4));
+        wavPut16(header + 34, 32);
+        memcpy(header + 36, "data", 4);
+        wavPut32(header + 40, 0);
+        return fwrite(header, 1, 44, mFile) == 44;
+    }
+
+    bool write(const float* interleaved, int numFrames) {
+        size_t numSamples = static_cast<size_t>(numFrames) * mNumChannels;
+        mBytes.resize(numSamples * 4);
+        for (size_t i = 0; i < numSamples; i++) {
+            uint32_t bits;
+            memcpy(&bits, &interleaved[i], sizeof(float));
+            wavPut32(&mBytes[i * 4], bits);
+        }
+        mNumFrames += numFrames;
+        return fwrite(mBytes.data(), 4, numSamples, mFile) == numSamples;
+    }
+
+    // Writes the sizes into the header and closes the file
+    bool close() {
+        if (!mFile) {
+            return true;
+        }
+        uint64_t dataSize = static_cast<uint64_t>(mNumFrames) * mNumChannels * 4;
+        unsigned char size[4];
+        bool ok = dataSize + 36 <= 0xFFFFFFFFu;
+        wavPut32(size, static_cast<uint32_t>(dataSize + 36));
+        ok = ok && fseek(mFile, 4, SEEK_SET) == 0 && fwrite(size, 1, 4, mFile) == 4;
+        wavPut32(size, static_cast<uint32_t>(dataSize));
+        ok = ok && fseek(mFile, 40, SEEK_SET) == 0 && fwrite(size, 1, 4, mFile) == 4;
+        ok = fclose(mFile) == 0 && ok;
+        mFile = nullptr;
+        return ok;
+    }
+};
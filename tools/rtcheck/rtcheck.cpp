@@ -0,0 +1,169 @@
+/*
+File: rtcheck.cpp
+Author: Jeff Martin
+
+Description:
+This file contains the real-time safety checker library. Preload it into scsynth or supernova
+with plugins built with SC_PLUGINS_RT_CHECK. It replaces the C library's allocation functions,
+pthread_mutex_lock and write, and reports each call made while a plugin Ctor, calc function or
+Dtor is running on the calling thread (see common/rtcheck.hpp). It relies on the glibc __libc_*
+allocation functions, so it only builds on Linux.
+
+Copyright © 2026 by Jeffrey Martin. All rights reserved.
+Website: https://www.jeffreymartincomposer.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define RTCHECK_EXPORT extern "C" __attribute__((visibility("default")))
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+typedef int (*MutexLockFunc)(pthread_mutex_t*);
+typedef ssize_t (*WriteFunc)(int, const void*, size_t);
+
+static MutexLockFunc gRealMutexLock = nullptr;
+static WriteFunc gRealWrite = nullptr;
+static bool gAbort = false;
+
+// The unit type and stage running on this thread, or null outside plugin code
+static __thread const char* tUnitName = nullptr;
+static __thread const char* tStage = nullptr;
+
+// Finds the functions this library replaces. The dynamic linker uses its own locks, so dlsym does not
+// come back into pthread_mutex_lock here.
+static MutexLockFunc realMutexLock() {
+    if (!gRealMutexLock)
+        gRealMutexLock = (MutexLockFunc)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    return gRealMutexLock;
+}
+
+static WriteFunc realWrite() {
+    if (!gRealWrite)
+        gRealWrite = (WriteFunc)dlsym(RTLD_NEXT, "write");
+    return gRealWrite;
+}
+
+__attribute__((constructor)) static void rtCheckInit() {
+    realMutexLock();
+    realWrite();
+    const char* abortSetting = getenv("RTCHECK_ABORT");
+    gAbort = abortSetting && abortSetting[0] && abortSetting[0] != '0';
+}
+
+RTCHECK_EXPORT void scPluginsRtCheckEnter(const char* unitName, const char* stage) {
+    tUnitName = unitName;
+    tStage = stage;
+}
+
+RTCHECK_EXPORT void scPluginsRtCheckLeave() {
+    tUnitName = nullptr;
+    tStage = nullptr;
+}
+
+// Reports a call made from plugin code, with a backtrace to find the call site
+static void rtCheckReport(const char* call) {
+    const char* unitName = tUnitName;
+    // The report itself may allocate or write, so stop checking until it is done
+    tUnitName = nullptr;
+    int savedErrno = errno;
+    char message[256];
+    int length = snprintf(message, sizeof(message), "rtcheck: %s in %s %s\n", call, unitName, tStage);
+    if (length > 0) {
+        realWrite()(STDERR_FILENO, message, length < (int)sizeof(message) ? length : sizeof(message) - 1);
+    }
+    void* frames[32];
+    int numFrames = backtrace(frames, 32);
+    // Skip this function and the replaced one
+    if (numFrames > 2) {
+        backtrace_symbols_fd(frames + 2, numFrames - 2, STDERR_FILENO);
+    }
+    if (gAbort) {
+        abort();
+    }
+    errno = savedErrno;
+    tUnitName = unitName;
+}
+
+RTCHECK_EXPORT void* malloc(size_t size) {
+    if (tUnitName)
+        rtCheckReport("malloc");
+    return __libc_malloc(size);
+}
+
+RTCHECK_EXPORT void* calloc(size_t count, size_t size) {
+    if (tUnitName)
+        rtCheckReport("calloc");
+    return __libc_calloc(count, size);
+}
+
+RTCHECK_EXPORT void* realloc(void* ptr, size_t size) {
+    if (tUnitName)
+        rtCheckReport("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+RTCHECK_EXPORT void* memalign(size_t alignment, size_t size) {
+    if (tUnitName)
+        rtCheckReport("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+RTCHECK_EXPORT void* aligned_alloc(size_t alignment, size_t size) {
+    if (tUnitName)
+        rtCheckReport("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+RTCHECK_EXPORT int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (tUnitName)
+        rtCheckReport("posix_memalign");
+    void* result = __libc_memalign(alignment, size);
+    if (!result)
+        return ENOMEM;
+    *ptr = result;
+    return 0;
+}
+
+RTCHECK_EXPORT void free(void* ptr) {
+    if (ptr && tUnitName)
+        rtCheckReport("free");
+    __libc_free(ptr);
+}
+
+RTCHECK_EXPORT int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (tUnitName)
+        rtCheckReport("pthread_mutex_lock");
+    return realMutexLock()(mutex);
+}
+
+RTCHECK_EXPORT ssize_t write(int fd, const void* buffer, size_t count) {
+    if (tUnitName)
+        rtCheckReport("write");
+    return realWrite()(fd, buffer, count);
+}